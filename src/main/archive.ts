@@ -0,0 +1,421 @@
+import fs from 'node:fs'
+import path from 'node:path'
+import zlib from 'node:zlib'
+import { Readable } from 'node:stream'
+
+/* ============================================================
+   Archive index reader — zip central directory & tar headers
+   ============================================================ */
+
+/**
+ * One entry of an archive's internal tree. Folder sizes are the sums of
+ * their contents. `compressedBytes` is unknown (undefined) for entries of
+ * compressed tarballs, which are compressed as a single stream.
+ */
+export interface ArchiveNode {
+  name: string
+  isDirectory: boolean
+  sizeBytes: number
+  compressedBytes?: number
+  mtimeMs: number
+  children?: Map<string, ArchiveNode>
+}
+
+type ArchiveKind = 'zip' | 'tar' | 'tar.gz' | 'tar.zst'
+
+const SUFFIXES: [string, ArchiveKind][] = [
+  ['.zip', 'zip'],
+  ['.tar', 'tar'],
+  ['.tar.gz', 'tar.gz'],
+  ['.tgz', 'tar.gz'],
+  ['.tar.zst', 'tar.zst'],
+  ['.tzst', 'tar.zst']
+]
+
+/**
+ * Most bytes a compressed tarball may inflate to while its headers are read,
+ * so a decompression bomb can't keep a core busy for minutes.
+ */
+const MAX_INFLATED_BYTES = Number(process.env.LFB_ARCHIVE_MAX_MB || 16 * 1024) * 1024 * 1024
+
+/** zstd streams need zlib.createZstdDecompress (Node 22.15+). */
+const hasZstd = typeof (zlib as any).createZstdDecompress === 'function'
+
+function archiveKind(name: string): ArchiveKind | null {
+  const lower = name.toLowerCase()
+  for (const [suffix, kind] of SUFFIXES) {
+    if (lower.endsWith(suffix)) return kind === 'tar.zst' && !hasZstd ? null : kind
+  }
+  return null
+}
+
+/** True when `name` looks like an archive this module can index. */
+export function isArchiveName(name: string): boolean {
+  return archiveKind(name) !== null
+}
+
+/* ---- tree building ---- */
+
+function newDir(name: string): ArchiveNode {
+  return { name, isDirectory: true, sizeBytes: 0, compressedBytes: 0, mtimeMs: 0, children: new Map() }
+}
+
+/** Add an entry by its '/'-separated path, creating implied folders. */
+function addEntry(root: ArchiveNode, entryPath: string, isDirectory: boolean, sizeBytes: number, compressedBytes: number | undefined, mtimeMs: number) {
+  const parts = entryPath.split('/').filter((p) => p && p !== '.')
+  if (parts.length === 0) return
+  let dir = root
+  for (let i = 0; i < parts.length - 1; i++) {
+    let next = dir.children!.get(parts[i])
+    if (!next) {
+      next = newDir(parts[i])
+      dir.children!.set(parts[i], next)
+    }
+    dir = next
+  }
+  const name = parts[parts.length - 1]
+  const existing = dir.children!.get(name)
+  if (isDirectory) {
+    if (!existing) dir.children!.set(name, { ...newDir(name), mtimeMs })
+    else existing.mtimeMs = Math.max(existing.mtimeMs, mtimeMs)
+    return
+  }
+  dir.children!.set(name, { name, isDirectory: false, sizeBytes, compressedBytes, mtimeMs })
+}
+
+/** Fill in folder totals bottom-up. */
+function sumTree(node: ArchiveNode) {
+  if (!node.children) return
+  let size = 0
+  let packed: number | undefined = 0
+  let latest = node.mtimeMs
+  for (const c of node.children.values()) {
+    sumTree(c)
+    size += c.sizeBytes
+    packed = packed === undefined || c.compressedBytes === undefined ? undefined : packed + c.compressedBytes
+    latest = Math.max(latest, c.mtimeMs)
+  }
+  node.sizeBytes = size
+  node.compressedBytes = packed
+  node.mtimeMs = latest
+}
+
+/* ---- zip ---- */
+
+const EOCD_SIG = 0x06054b50
+const ZIP64_LOCATOR_SIG = 0x07064b50
+const ZIP64_EOCD_SIG = 0x06064b50
+const CDH_SIG = 0x02014b50
+/** EOCD record plus the longest possible archive comment. */
+const EOCD_SEARCH = 22 + 0xffff
+
+function readAt(fd: number, position: number, length: number): Buffer {
+  const buf = Buffer.alloc(length)
+  let got = 0
+  while (got < length) {
+    const n = fs.readSync(fd, buf, got, length - got, position + got)
+    if (n === 0) break
+    got += n
+  }
+  return got === length ? buf : buf.subarray(0, got)
+}
+
+function dosTimeMs(time: number, date: number): number {
+  return new Date(
+    1980 + (date >> 9), ((date >> 5) & 0xf) - 1, date & 0x1f,
+    time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2
+  ).getTime()
+}
+
+/** Read only the zip central directory — never the compressed data. */
+function readZipIndex(file: string): ArchiveNode {
+  const fd = fs.openSync(file, 'r')
+  try {
+    const size = fs.fstatSync(fd).size
+    const tailStart = Math.max(0, size - EOCD_SEARCH)
+    const tail = readAt(fd, tailStart, size - tailStart)
+    let eocd = -1
+    for (let i = tail.length - 22; i >= 0; i--) {
+      if (tail.readUInt32LE(i) === EOCD_SIG) { eocd = i; break }
+    }
+    if (eocd < 0) throw new Error('not a zip file')
+
+    let count = tail.readUInt16LE(eocd + 10)
+    let cdSize = tail.readUInt32LE(eocd + 12)
+    let cdOffset = tail.readUInt32LE(eocd + 16)
+    // ZIP64: the real values live in the zip64 end record
+    if (eocd >= 20 && tail.readUInt32LE(eocd - 20) === ZIP64_LOCATOR_SIG) {
+      const z = readAt(fd, Number(tail.readBigUInt64LE(eocd - 12)), 56)
+      if (z.readUInt32LE(0) === ZIP64_EOCD_SIG) {
+        count = Number(z.readBigUInt64LE(32))
+        cdSize = Number(z.readBigUInt64LE(40))
+        cdOffset = Number(z.readBigUInt64LE(48))
+      }
+    }
+
+    const cd = readAt(fd, cdOffset, cdSize)
+    const root = newDir('')
+    let p = 0
+    for (let n = 0; n < count && p + 46 <= cd.length && cd.readUInt32LE(p) === CDH_SIG; n++) {
+      const flags = cd.readUInt16LE(p + 8)
+      const mtimeMs = dosTimeMs(cd.readUInt16LE(p + 12), cd.readUInt16LE(p + 14))
+      let packed = cd.readUInt32LE(p + 20)
+      let unpacked = cd.readUInt32LE(p + 24)
+      const nameLen = cd.readUInt16LE(p + 28)
+      const extraLen = cd.readUInt16LE(p + 30)
+      const commentLen = cd.readUInt16LE(p + 32)
+      // Bit 11: UTF-8 names; otherwise CP437, close enough to latin1 here
+      const name = cd.toString(flags & 0x800 ? 'utf8' : 'latin1', p + 46, p + 46 + nameLen).replace(/\\/g, '/')
+
+      // Saturated sizes continue in the zip64 extra field, in this order
+      let x = p + 46 + nameLen
+      const extraEnd = x + extraLen
+      while (x + 4 <= extraEnd) {
+        const id = cd.readUInt16LE(x)
+        const len = cd.readUInt16LE(x + 2)
+        if (id === 0x0001) {
+          let f = x + 4
+          if (unpacked === 0xffffffff) { unpacked = Number(cd.readBigUInt64LE(f)); f += 8 }
+          if (packed === 0xffffffff) packed = Number(cd.readBigUInt64LE(f))
+          break
+        }
+        x += 4 + len
+      }
+
+      addEntry(root, name, name.endsWith('/'), unpacked, packed, mtimeMs)
+      p = extraEnd + commentLen
+    }
+    return root
+  } finally {
+    fs.closeSync(fd)
+  }
+}
+
+/* ---- tar ---- */
+
+const BLOCK = 512
+
+function tarString(b: Buffer, start: number, len: number): string {
+  const end = b.indexOf(0, start)
+  return b.toString('utf8', start, end < 0 || end > start + len ? start + len : end)
+}
+
+/** Octal numeric field, or GNU base-256 when the high bit is set. */
+function tarNumber(b: Buffer, start: number, len: number): number {
+  if (b[start] & 0x80) {
+    let v = 0
+    for (let i = start + 1; i < start + len; i++) v = v * 256 + b[i]
+    return v
+  }
+  return parseInt(tarString(b, start, len).trim() || '0', 8)
+}
+
+/** PAX records: "<len> key=value\n" repeated. */
+function paxRecords(data: Buffer): Map<string, string> {
+  const out = new Map<string, string>()
+  let p = 0
+  while (p < data.length) {
+    const sp = data.indexOf(0x20, p)
+    if (sp < 0) break
+    const len = parseInt(data.toString('ascii', p, sp), 10)
+    if (!len) break
+    const rec = data.toString('utf8', sp + 1, p + len - 1)
+    const eq = rec.indexOf('=')
+    if (eq > 0) out.set(rec.slice(0, eq), rec.slice(eq + 1))
+    p += len
+  }
+  return out
+}
+
+/**
+ * Consumes tar headers one block at a time. Member data is only kept for
+ * the small metadata members (GNU long names, PAX headers); everything else
+ * is counted past without being stored.
+ */
+class TarHeaderReader {
+  readonly root = newDir('')
+  done = false
+  /** Bytes of member data still to pass over before the next header. */
+  skip = 0
+  private meta: { type: string; buf: Buffer; got: number } | null = null
+  private longName: string | null = null
+  private pax: Map<string, string> | null = null
+
+  /** Feed one 512-byte block that is known to be a header or metadata. */
+  block(b: Buffer) {
+    if (this.meta) {
+      const m = this.meta
+      b.copy(m.buf, m.got, 0, Math.min(BLOCK, m.buf.length - m.got))
+      m.got += BLOCK
+      if (m.got >= m.buf.length) {
+        if (m.type === 'L') this.longName = tarString(m.buf, 0, m.buf.length)
+        else this.pax = paxRecords(m.buf)
+        this.meta = null
+      }
+      return
+    }
+    if (b.every((v) => v === 0)) {
+      this.done = true
+      return
+    }
+    const type = String.fromCharCode(b[156] || 0x30)
+    let size = tarNumber(b, 124, 12)
+    if (type === 'L' || type === 'x') {
+      this.meta = { type, buf: Buffer.alloc(size), got: 0 }
+      if (size === 0) this.meta = null
+      return
+    }
+    if (type === 'g') {
+      // Global PAX header: nothing per entry to take from it
+      this.skip = Math.ceil(size / BLOCK) * BLOCK
+      return
+    }
+    let name = tarString(b, 0, 100)
+    if (b.toString('ascii', 257, 262) === 'ustar') {
+      const prefix = tarString(b, 345, 155)
+      if (prefix) name = `${prefix}/${name}`
+    }
+    if (this.longName) name = this.longName
+    if (this.pax?.has('path')) name = this.pax.get('path')!
+    if (this.pax?.has('size')) size = Number(this.pax.get('size'))
+    this.longName = null
+    this.pax = null
+
+    const mtimeMs = tarNumber(b, 136, 12) * 1000
+    if (type === '5') addEntry(this.root, name, true, 0, undefined, mtimeMs)
+    else if (type === '0' || type === '7' || type === '\0') addEntry(this.root, name, false, size, undefined, mtimeMs)
+    // Links, devices and fifos take no space of their own
+    this.skip = Math.ceil(size / BLOCK) * BLOCK
+  }
+
+  /** True while the next block is metadata rather than skippable data. */
+  get wantsData(): boolean {
+    return this.meta !== null
+  }
+}
+
+/** Plain tar: hop from header to header with positioned reads. */
+function readTarIndex(file: string): ArchiveNode {
+  const fd = fs.openSync(file, 'r')
+  try {
+    const size = fs.fstatSync(fd).size
+    const reader = new TarHeaderReader()
+    let pos = 0
+    while (!reader.done && pos + BLOCK <= size) {
+      reader.block(readAt(fd, pos, BLOCK))
+      pos += BLOCK + reader.skip
+      reader.skip = 0
+    }
+    // Uncompressed: stored size is the packed size
+    const mark = (n: ArchiveNode) => {
+      if (n.children) n.children.forEach(mark)
+      else n.compressedBytes = n.sizeBytes
+    }
+    mark(reader.root)
+    return reader.root
+  } finally {
+    fs.closeSync(fd)
+  }
+}
+
+/**
+ * Compressed tar: one streaming decompression pass, discarding member data.
+ * Stops with an error once `signal` aborts or the stream inflates past
+ * MAX_INFLATED_BYTES.
+ */
+async function readCompressedTarIndex(file: string, kind: ArchiveKind, signal?: AbortSignal): Promise<ArchiveNode> {
+  const decompress = kind === 'tar.gz' ? zlib.createGunzip() : (zlib as any).createZstdDecompress()
+  const source = fs.createReadStream(file)
+  const stream: Readable = source.pipe(decompress)
+  const reader = new TarHeaderReader()
+  let pending = Buffer.alloc(0)
+  let inflated = 0
+  try {
+    for await (const chunk of stream as AsyncIterable<Buffer>) {
+      signal?.throwIfAborted()
+      inflated += chunk.length
+      if (inflated > MAX_INFLATED_BYTES) throw new Error(`${file} inflates past ${MAX_INFLATED_BYTES} bytes`)
+      let buf = pending.length ? Buffer.concat([pending, chunk]) : chunk
+      let p = 0
+      while (!reader.done) {
+        if (reader.skip > 0) {
+          const n = Math.min(reader.skip, buf.length - p)
+          reader.skip -= n
+          p += n
+          if (reader.skip > 0) break
+        }
+        if (buf.length - p < BLOCK) break
+        reader.block(buf.subarray(p, p + BLOCK))
+        p += BLOCK
+      }
+      pending = Buffer.from(buf.subarray(p))
+      buf = pending
+      if (reader.done) break
+    }
+  } finally {
+    source.destroy()
+    decompress.destroy()
+  }
+  return reader.root
+}
+
+/* ---- public API ---- */
+
+/** Parsed indexes of recently opened archives, keyed by path, size and mtime. */
+const cache = new Map<string, ArchiveNode>()
+const CACHE_SIZE = 8
+
+/**
+ * The archive's internal tree with folder totals filled in. Aborting
+ * `signal` stops the read of a compressed tarball part-way.
+ */
+export async function readArchiveIndex(file: string, signal?: AbortSignal): Promise<ArchiveNode> {
+  const kind = archiveKind(file)
+  if (!kind) throw new Error(`unsupported archive: ${file}`)
+  const s = fs.statSync(file)
+  const key = `${file}\0${s.size}\0${s.mtimeMs}`
+  const hit = cache.get(key)
+  if (hit) {
+    cache.delete(key)
+    cache.set(key, hit)
+    return hit
+  }
+  const root = kind === 'zip' ? readZipIndex(file)
+    : kind === 'tar' ? readTarIndex(file)
+      : await readCompressedTarIndex(file, kind, signal)
+  sumTree(root)
+  root.compressedBytes ??= s.size
+  cache.set(key, root)
+  if (cache.size > CACHE_SIZE) cache.delete(cache.keys().next().value!)
+  return root
+}
+
+/**
+ * Split a virtual path like `D:\dl\bundle.zip\docs\a.pdf` into the archive
+ * file and the '/'-separated path inside it. Null when no ancestor (or the
+ * path itself) is an archive file.
+ */
+export function splitArchivePath(p: string): { archive: string; inner: string } | null {
+  for (let cur = p; ; ) {
+    try {
+      const s = fs.statSync(cur)
+      if (!s.isFile() || !isArchiveName(cur)) return null
+      return { archive: cur, inner: path.relative(cur, p).split(path.sep).join('/') }
+    } catch {
+      /* not on disk — may be inside an archive further up */
+    }
+    const up = path.dirname(cur)
+    if (up === cur) return null
+    cur = up
+  }
+}
+
+/** The node at `inner` ('' = archive root), or null if there is none. */
+export function findArchiveNode(root: ArchiveNode, inner: string): ArchiveNode | null {
+  let node: ArchiveNode | undefined = root
+  for (const part of inner.split('/').filter(Boolean)) {
+    node = node?.children?.get(part)
+    if (!node) return null
+  }
+  return node
+}
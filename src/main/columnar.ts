@@ -0,0 +1,402 @@
+import fs from 'node:fs'
+import path from 'node:path'
+import { randomUUID } from 'node:crypto'
+import { ItemRecord, ItemType } from '../shared/types'
+import { ItemBatch, registerRoot, treeChildren, treeRoot, upsertBatch, whenDurable } from './db'
+
+/* ============================================================
+   Scan files — one root's rows as fixed-width columns
+   ============================================================ */
+
+/**
+ * A scan file holds one scanned root for sharing or archiving. After a
+ * 64-byte header come one little-endian array per column, each starting
+ * on an 8-byte boundary, then the names as one UTF-8 blob. Rows are in
+ * depth-first order: row 0 is the root, named by its full path, and the
+ * rows below row r are exactly r + 1 up to end[r] — so a subtree is one
+ * run of every column.
+ *
+ *   header  'LFBSCAN\0', u32 version, u32 rows, f64 name bytes, f64 exported ms
+ *   f64     sizeBytes, fileCount, folderCount, lastWriteMs, scannedMs
+ *   i32     parent (row index; -1 for the root)
+ *   u32     end, nameEnd (offset just past the row's name)
+ *   u16     depth
+ *   u8      type (1 = folder)
+ *   names
+ *
+ * Every offset follows from the row count and name bytes, so a column is
+ * one read into a typed array of its own, with nothing to decode. Node
+ * cannot map files into memory, so ScanFile reads each column when a
+ * query first needs it instead: opening reads the header alone.
+ */
+const MAGIC = 'LFBSCAN\0'
+const FORMAT_VERSION = 1
+const HEADER_BYTES = 64
+/** Rows exported between yields to the event loop. */
+const STEP_ROWS = 5_000
+
+type ColumnName = 'sizeBytes' | 'fileCount' | 'folderCount' | 'lastWriteMs' | 'scannedMs'
+  | 'parent' | 'end' | 'nameEnd' | 'depth' | 'type' | 'names'
+
+type ColumnArray = Float64Array | Int32Array | Uint32Array | Uint16Array | Uint8Array
+
+const COLUMNS: [ColumnName, { new (n: number): ColumnArray; BYTES_PER_ELEMENT: number }][] = [
+  ['sizeBytes', Float64Array],
+  ['fileCount', Float64Array],
+  ['folderCount', Float64Array],
+  ['lastWriteMs', Float64Array],
+  ['scannedMs', Float64Array],
+  ['parent', Int32Array],
+  ['end', Uint32Array],
+  ['nameEnd', Uint32Array],
+  ['depth', Uint16Array],
+  ['type', Uint8Array],
+  ['names', Uint8Array]
+]
+
+/** Byte offset and element count of every column for `rows` rows and `nameBytes` of names. */
+function layout(rows: number, nameBytes: number): Map<ColumnName, { offset: number; length: number }> {
+  const at = new Map<ColumnName, { offset: number; length: number }>()
+  let offset = HEADER_BYTES
+  for (const [name, type] of COLUMNS) {
+    const length = name === 'names' ? nameBytes : rows
+    at.set(name, { offset, length })
+    offset += Math.ceil((length * type.BYTES_PER_ELEMENT) / 8) * 8
+  }
+  return at
+}
+
+/** The parent of `p` as the database layer names it: null for a volume root. */
+function parentOf(p: string): string | null {
+  const d = path.dirname(p)
+  return d === p ? null : d
+}
+
+function joinPath(parent: string, name: string): string {
+  return parent.endsWith(path.sep) ? parent + name : parent + path.sep + name
+}
+
+/**
+ * Write the rows of `rootPath` in shard `db` to the scan file `file`,
+ * replacing it whole once complete. The tree is read a folder at a time,
+ * depth-first, with the event loop run every STEP_ROWS rows. Returns the
+ * number of rows, or 0 when the root has no rows to write.
+ */
+export async function exportScanFile(db: any, rootPath: string, file: string): Promise<number> {
+  const cols = new Map<ColumnName, ColumnArray>()
+  let capacity = 0
+  let names = Buffer.alloc(1 << 16)
+  let nameBytes = 0
+  let rows = 0
+  // Rows whose subtree is still being read, and their levels
+  const openRows: number[] = []
+  const openLevels: number[] = []
+  let size!: Float64Array, files!: Float64Array, folders!: Float64Array, lastWrite!: Float64Array, scanned!: Float64Array
+  let parent!: Int32Array, end!: Uint32Array, nameEnd!: Uint32Array, depth!: Uint16Array, kind!: Uint8Array
+  const grow = () => {
+    capacity = Math.max(1024, capacity * 2)
+    for (const [name, type] of COLUMNS) {
+      if (name === 'names') continue
+      const grown = new type(capacity)
+      const old = cols.get(name)
+      if (old) grown.set(old)
+      cols.set(name, grown)
+    }
+    size = cols.get('sizeBytes') as Float64Array
+    files = cols.get('fileCount') as Float64Array
+    folders = cols.get('folderCount') as Float64Array
+    lastWrite = cols.get('lastWriteMs') as Float64Array
+    scanned = cols.get('scannedMs') as Float64Array
+    parent = cols.get('parent') as Int32Array
+    end = cols.get('end') as Uint32Array
+    nameEnd = cols.get('nameEnd') as Uint32Array
+    depth = cols.get('depth') as Uint16Array
+    kind = cols.get('type') as Uint8Array
+  }
+
+  const root = treeRoot(db, rootPath)
+  if (!root) return 0
+  // Rows still to be written, the next on top; a folder's children go on when it is written
+  const pending = [{ r: root, level: 0 }]
+  while (pending.length) {
+    const { r, level } = pending.pop()!
+    if (rows === capacity) grow()
+    while (openLevels.length && openLevels[openLevels.length - 1] >= level) {
+      openLevels.pop()
+      end[openRows.pop()!] = rows
+    }
+    const name = level === 0 ? rootPath : String(r.name)
+    // A UTF-8 name takes at most three bytes per UTF-16 unit
+    if (nameBytes + name.length * 3 > names.length) {
+      const grown = Buffer.alloc(Math.max(names.length * 2, nameBytes + name.length * 3))
+      names.copy(grown, 0, 0, nameBytes)
+      names = grown
+    }
+    nameBytes += names.write(name, nameBytes, 'utf8')
+    size[rows] = r.sizeBytes
+    files[rows] = r.fileCount
+    folders[rows] = r.folderCount
+    lastWrite[rows] = r.lastWriteMs
+    scanned[rows] = r.scannedMs
+    parent[rows] = openRows.length ? openRows[openRows.length - 1] : -1
+    nameEnd[rows] = nameBytes
+    depth[rows] = r.depth
+    kind[rows] = r.type === 'Folder' ? 1 : 0
+    openRows.push(rows)
+    openLevels.push(level)
+    rows++
+    if (r.type === 'Folder') for (const c of treeChildren(db, Number(r.nodeId))) pending.push({ r: c, level: level + 1 })
+    if (rows % STEP_ROWS === 0) await new Promise((resolve) => setImmediate(resolve))
+  }
+  for (const row of openRows) end[row] = rows
+
+  const header = Buffer.alloc(HEADER_BYTES)
+  header.write(MAGIC, 0, 'latin1')
+  header.writeUInt32LE(FORMAT_VERSION, 8)
+  header.writeUInt32LE(rows, 12)
+  header.writeDoubleLE(nameBytes, 16)
+  header.writeDoubleLE(Date.now(), 24)
+  const tmp = `${file}.tmp`
+  const fd = fs.openSync(tmp, 'w')
+  try {
+    fs.writeSync(fd, header, 0, HEADER_BYTES, 0)
+    for (const [name, { offset, length }] of layout(rows, nameBytes)) {
+      const data = name === 'names' ? names.subarray(0, nameBytes) : cols.get(name)!.subarray(0, length)
+      fs.writeSync(fd, new Uint8Array(data.buffer, data.byteOffset, data.byteLength), 0, data.byteLength, offset)
+    }
+  } finally {
+    fs.closeSync(fd)
+  }
+  fs.renameSync(tmp, file)
+  return rows
+}
+
+/**
+ * An open scan file, queried in place: top lists and folder listings read
+ * the columns they need, and no database is built.
+ */
+export class ScanFile {
+  readonly rows: number
+  readonly exportedMs: number
+  private readonly at: Map<ColumnName, { offset: number; length: number }>
+  private readonly loaded = new Map<ColumnName, ColumnArray>()
+  private readonly decoder = new TextDecoder()
+  private root: string | null = null
+
+  private constructor(private fd: number, readonly file: string) {
+    const header = Buffer.alloc(HEADER_BYTES)
+    fs.readSync(fd, header, 0, HEADER_BYTES, 0)
+    if (header.toString('latin1', 0, 8) !== MAGIC) throw new Error(`${file} is not a scan file`)
+    const version = header.readUInt32LE(8)
+    if (version !== FORMAT_VERSION) throw new Error(`${file} has scan file version ${version}; this build reads ${FORMAT_VERSION}`)
+    this.rows = header.readUInt32LE(12)
+    this.exportedMs = header.readDoubleLE(24)
+    this.at = layout(this.rows, header.readDoubleLE(16))
+    const names = this.at.get('names')!
+    if (fs.fstatSync(fd).size < names.offset + names.length) throw new Error(`${file} is truncated`)
+  }
+
+  static open(file: string): ScanFile {
+    const fd = fs.openSync(file, 'r')
+    try {
+      return new ScanFile(fd, file)
+    } catch (err) {
+      fs.closeSync(fd)
+      throw err
+    }
+  }
+
+  close() {
+    if (this.fd < 0) return
+    fs.closeSync(this.fd)
+    this.fd = -1
+    this.loaded.clear()
+  }
+
+  /** The root's full path (row 0's name). */
+  get rootPath(): string {
+    return (this.root ??= this.name(0))
+  }
+
+  /** A column, read into memory on first use. */
+  private column<T extends ColumnArray>(name: ColumnName): T {
+    let data = this.loaded.get(name)
+    if (!data) {
+      const { offset, length } = this.at.get(name)!
+      const type = COLUMNS.find(([n]) => n === name)![1]
+      data = new type(length)
+      const bytes = new Uint8Array(data.buffer)
+      for (let done = 0; done < bytes.length;) {
+        const n = fs.readSync(this.fd, bytes, done, bytes.length - done, offset + done)
+        if (n === 0) throw new Error(`${this.file} is truncated`)
+        done += n
+      }
+      this.loaded.set(name, data)
+    }
+    return data as T
+  }
+
+  private name(row: number): string {
+    const nameEnd = this.column<Uint32Array>('nameEnd')
+    return this.decoder.decode(this.column<Uint8Array>('names').subarray(row === 0 ? 0 : nameEnd[row - 1], nameEnd[row]))
+  }
+
+  pathOf(row: number): string {
+    const parent = this.column<Int32Array>('parent')[row]
+    return parent < 0 ? this.name(0) : joinPath(this.pathOf(parent), this.name(row))
+  }
+
+  /** The row of `p`, or -1 when the file does not hold it. */
+  find(p: string): number {
+    const root = this.rootPath
+    if (p === root) return 0
+    const prefix = root.endsWith(path.sep) ? root : root + path.sep
+    if (!p.startsWith(prefix)) return -1
+    const end = this.column<Uint32Array>('end')
+    let row = 0
+    for (const part of p.slice(prefix.length).split(path.sep)) {
+      let found = -1
+      for (let c = row + 1; c < end[row]; c = end[c]) {
+        if (this.name(c) === part) {
+          found = c
+          break
+        }
+      }
+      if (found < 0) return -1
+      row = found
+    }
+    return row
+  }
+
+  record(row: number, p = this.pathOf(row)): ItemRecord {
+    return {
+      path: p,
+      parent: parentOf(p),
+      type: this.column<Uint8Array>('type')[row] ? 'Folder' : 'File',
+      sizeBytes: this.column<Float64Array>('sizeBytes')[row],
+      fileCount: this.column<Float64Array>('fileCount')[row],
+      folderCount: this.column<Float64Array>('folderCount')[row],
+      lastWriteMs: this.column<Float64Array>('lastWriteMs')[row],
+      scannedMs: this.column<Float64Array>('scannedMs')[row],
+      depth: this.column<Uint16Array>('depth')[row],
+      runId: ''
+    }
+  }
+
+  /**
+   * The `limit` largest rows of `type`, in the whole file or below
+   * `under` — one pass over a run of the size and type columns.
+   */
+  top(type: ItemType, limit = 100, under?: string): ItemRecord[] {
+    let from = 0
+    let to = this.rows
+    if (under !== undefined) {
+      const row = this.find(under)
+      if (row < 0) return []
+      from = row + 1
+      to = this.column<Uint32Array>('end')[row]
+    }
+    const size = this.column<Float64Array>('sizeBytes')
+    const kind = this.column<Uint8Array>('type')
+    const want = type === 'Folder' ? 1 : 0
+    // Row numbers, largest first
+    const best: number[] = []
+    for (let r = from; r < to; r++) {
+      if (kind[r] !== want) continue
+      if (best.length === limit && size[r] <= size[best[limit - 1]]) continue
+      let lo = 0
+      let hi = best.length
+      while (lo < hi) {
+        const mid = (lo + hi) >> 1
+        if (size[best[mid]] >= size[r]) lo = mid + 1
+        else hi = mid
+      }
+      best.splice(lo, 0, r)
+      if (best.length > limit) best.pop()
+    }
+    return best.map((r) => this.record(r))
+  }
+
+  /** The rows directly below `parent`, largest first, each carrying its subtree's totals. */
+  children(parent: string, limit = 200, includeFiles = true): { items: ItemRecord[]; total: number } {
+    const row = this.find(parent)
+    if (row < 0) return { items: [], total: 0 }
+    const end = this.column<Uint32Array>('end')
+    const kind = this.column<Uint8Array>('type')
+    const size = this.column<Float64Array>('sizeBytes')
+    const rows: number[] = []
+    for (let c = row + 1; c < end[row]; c = end[c]) if (includeFiles || kind[c]) rows.push(c)
+    rows.sort((a, b) => size[b] - size[a])
+    const items = rows.slice(0, limit).map((c) => this.record(c, joinPath(parent, this.name(c))))
+    return { items, total: rows.length }
+  }
+
+  /**
+   * Write every row into shard `db` as one scan of the root: folders are
+   * listed in full, so rows of the root the file does not have are
+   * removed. Rows go children first, as a scan writes them; they count as
+   * not scanned on this machine (scannedMs 0) unless they were before.
+   */
+  async importInto(db: any, dbPath: string): Promise<string> {
+    const runId = randomUUID()
+    const parent = this.column<Int32Array>('parent')
+    const kind = this.column<Uint8Array>('type')
+    const size = this.column<Float64Array>('sizeBytes')
+    const fileCount = this.column<Float64Array>('fileCount')
+    const folderCount = this.column<Float64Array>('folderCount')
+    const lastWrite = this.column<Float64Array>('lastWriteMs')
+    const depth = this.column<Uint16Array>('depth')
+    // Folder paths, built parents first; file paths follow from them
+    const folders = new Map<number, string>()
+    for (let r = 0; r < this.rows; r++) {
+      if (kind[r]) folders.set(r, r === 0 ? this.rootPath : joinPath(folders.get(parent[r])!, this.name(r)))
+    }
+    registerRoot(db, this.rootPath)
+    const batch = new ItemBatch()
+    for (let r = this.rows - 1; r >= 0; r--) {
+      const p = kind[r] ? folders.get(r)! : joinPath(folders.get(parent[r])!, this.name(r))
+      const up = r === 0 ? parentOf(p) : folders.get(parent[r])!
+      if (kind[r]) {
+        const totals = { sizeBytes: size[r], fileCount: fileCount[r], folderCount: folderCount[r], latestMs: lastWrite[r] }
+        batch.pushFolder(p, up, depth[r], runId, totals, false, null, true)
+      } else {
+        batch.pushFile(p, up, depth[r], runId, size[r], lastWrite[r], false)
+      }
+      if (batch.full) {
+        upsertBatch(db, dbPath, batch)
+        // Let the commit timer and IPC run between batches
+        await new Promise((resolve) => setImmediate(resolve))
+      }
+    }
+    upsertBatch(db, dbPath, batch)
+    await whenDurable(db, dbPath)
+    return this.rootPath
+  }
+}
+
+/** Scan files kept open for queries, by path; the oldest closes past OPEN_FILES. */
+const openFiles = new Map<string, { file: ScanFile; mtimeMs: number }>()
+const OPEN_FILES = 4
+
+/** The scan file at `file`, opened once and reopened when it changed on disk. */
+export function openScanFile(file: string): ScanFile {
+  const resolved = path.resolve(file)
+  const mtimeMs = fs.statSync(resolved).mtimeMs
+  const hit = openFiles.get(resolved)
+  if (hit) {
+    openFiles.delete(resolved)
+    if (hit.mtimeMs === mtimeMs) {
+      openFiles.set(resolved, hit)
+      return hit.file
+    }
+    hit.file.close()
+  }
+  const opened = ScanFile.open(resolved)
+  openFiles.set(resolved, { file: opened, mtimeMs })
+  for (const [key, o] of openFiles) {
+    if (openFiles.size <= OPEN_FILES) break
+    o.file.close()
+    openFiles.delete(key)
+  }
+  return opened
+}
@@ -2,24 +2,21 @@ import initSqlJs from 'sql.js'
 import path from 'node:path'
 import fs from 'node:fs'
 import { app } from 'electron'
-import { ItemRecord, ItemType } from '../shared/types'
+import { FilterTerm, FolderSizeAt, GrowthEntry, ItemRecord, ItemType, SearchRequest, SnapshotInfo } from '../shared/types'
+import { FsIdStat } from './fsprovider'
+import { NativeDatabase, nativeSqlite } from './sqlite'
+import { markPersisted, persistImage, recoverJournal, whenPersisted } from './persist'
 
 const isDev = process.env.NODE_ENV === 'development'
   || !app.isPackaged
 
-/** Prefix object keys with `:` for sql.js named-parameter binding. */
-function sqlBind(obj: Record<string, any>): Record<string, any> {
-  const out: Record<string, any> = {}
-  for (const [k, v] of Object.entries(obj)) {
-    out[`:${k}`] = v
-  }
-  return out
-}
-
-// In dev, store DB alongside project; in production, use appData
-const defaultDbPath = isDev
-  ? path.resolve(process.cwd(), 'data', 'lfb.sqlite')
-  : path.join(app.getPath('userData'), 'data', 'lfb.sqlite')
+// In dev, store DB alongside project; in production, use appData.
+// LFB_DATA_DIR overrides both, so tests can run on a scratch directory.
+export const defaultDbPath = process.env.LFB_DATA_DIR
+  ? path.resolve(process.env.LFB_DATA_DIR, 'lfb.sqlite')
+  : isDev
+    ? path.resolve(process.cwd(), 'data', 'lfb.sqlite')
+    : path.join(app.getPath('userData'), 'data', 'lfb.sqlite')
 let SQL: any
 
 function locateWasmFile(file: string): string {
@@ -43,34 +40,505 @@ async function loadSql() {
   return SQL
 }
 
+/**
+ * Schema version kept in PRAGMA user_version. Version 0 is the original
+ * layout, one `items` row per full path string; version 2 stores the path
+ * tree as `nodes` (id, parentId, name) and keys `items` by node id;
+ * version 3 adds the `roots` table behind the root view; version 4 copies
+ * parentId onto `items` and keeps per-folder child counts there; version 5
+ * stores timestamps as epoch-ms integers instead of ISO-8601 text; version
+ * 6 adds scan history (`snapshots` + `snapshot_deltas`); version 7 keeps
+ * the history of deleted folders as path-keyed `snapshot_tombstones`.
+ */
+const SCHEMA_VERSION = 7
+
+function tableColumns(db: any, table: string): Set<string> {
+  const have = new Set<string>()
+  const info = db.prepare(`PRAGMA table_info(${table})`)
+  while (info.step()) have.add(String(info.getAsObject().name))
+  info.free()
+  return have
+}
+
+function userVersion(db: any): number {
+  const stmt = db.prepare('PRAGMA user_version')
+  const v = stmt.step() ? Number(Object.values(stmt.getAsObject())[0]) : 0
+  stmt.free()
+  return v
+}
+
 function applySchema(db: any) {
+  const version = userVersion(db)
+  const legacy = version < 2 && tableColumns(db, 'items').has('path')
+  if (legacy) {
+    db.run('ALTER TABLE items RENAME TO items_v1')
+    for (const idx of ['idx_items_parent', 'idx_items_size', 'idx_items_type', 'idx_items_inode']) {
+      db.run(`DROP INDEX IF EXISTS ${idx}`)
+    }
+  }
   db.run(`
+    CREATE TABLE IF NOT EXISTS nodes (
+      id INTEGER PRIMARY KEY,
+      parentId INTEGER NOT NULL,
+      rootId INTEGER NOT NULL,
+      name TEXT NOT NULL,
+      UNIQUE (parentId, name)
+    );
     CREATE TABLE IF NOT EXISTS items (
-      path TEXT PRIMARY KEY,
-      parent TEXT,
+      nodeId INTEGER PRIMARY KEY,
       type TEXT NOT NULL,
       sizeBytes INTEGER NOT NULL,
       fileCount INTEGER NOT NULL,
       folderCount INTEGER NOT NULL,
-      lastWriteUtc TEXT NOT NULL,
-      scannedUtc TEXT NOT NULL,
+      lastWriteMs INTEGER NOT NULL,
+      scannedMs INTEGER NOT NULL,
       depth INTEGER NOT NULL,
-      runId TEXT NOT NULL
+      runId TEXT NOT NULL,
+      dev TEXT,
+      ino TEXT,
+      dirMtimeMs INTEGER,
+      parentId INTEGER NOT NULL DEFAULT 0,
+      childCount INTEGER NOT NULL DEFAULT 0,
+      childFolderCount INTEGER NOT NULL DEFAULT 0
     );
-    CREATE INDEX IF NOT EXISTS idx_items_parent ON items(parent);
+    CREATE TABLE IF NOT EXISTS roots (
+      nodeId INTEGER PRIMARY KEY
+    );
+    CREATE TABLE IF NOT EXISTS snapshots (
+      id INTEGER PRIMARY KEY,
+      rootId INTEGER NOT NULL,
+      runId TEXT NOT NULL,
+      takenMs INTEGER NOT NULL,
+      -- Set, with rootId 0, once the root folder is deleted
+      rootPath TEXT
+    );
+    CREATE TABLE IF NOT EXISTS snapshot_deltas (
+      nodeId INTEGER NOT NULL,
+      snapshotId INTEGER NOT NULL,
+      sizeBytes INTEGER NOT NULL,
+      fileCount INTEGER NOT NULL,
+      folderCount INTEGER NOT NULL,
+      PRIMARY KEY (nodeId, snapshotId)
+    ) WITHOUT ROWID;
+    CREATE TABLE IF NOT EXISTS snapshot_tombstones (
+      path TEXT NOT NULL,
+      snapshotId INTEGER NOT NULL,
+      sizeBytes INTEGER NOT NULL,
+      fileCount INTEGER NOT NULL,
+      folderCount INTEGER NOT NULL,
+      -- Newest snapshot taken while the folder existed, and when it went
+      lastSnapshotId INTEGER NOT NULL,
+      goneMs INTEGER NOT NULL,
+      PRIMARY KEY (path, snapshotId)
+    ) WITHOUT ROWID;
+    -- Scratch list of node ids for sweepChildren(); per connection
+    CREATE TEMP TABLE IF NOT EXISTS swept (
+      id INTEGER PRIMARY KEY
+    );
+  `)
+  if (!tableColumns(db, 'items').has('parentId')) {
+    db.run(`
+      ALTER TABLE items ADD COLUMN parentId INTEGER NOT NULL DEFAULT 0;
+      ALTER TABLE items ADD COLUMN childCount INTEGER NOT NULL DEFAULT 0;
+      ALTER TABLE items ADD COLUMN childFolderCount INTEGER NOT NULL DEFAULT 0;
+    `)
+  }
+  if (!tableColumns(db, 'snapshots').has('rootPath')) db.run('ALTER TABLE snapshots ADD COLUMN rootPath TEXT')
+  const isoTimes = tableColumns(db, 'items').has('lastWriteUtc')
+  if (isoTimes) convertIsoTimes(db)
+  // Bulk-copy old rows before the secondary indexes exist; far faster
+  if (legacy) migratePathRows(db)
+  if (version < 3) adoptOrphanRoots(db)
+  if (version < 4) db.run('UPDATE items SET parentId = (SELECT parentId FROM nodes WHERE id = items.nodeId)')
+  db.run(`
     CREATE INDEX IF NOT EXISTS idx_items_size ON items(sizeBytes DESC);
     CREATE INDEX IF NOT EXISTS idx_items_type ON items(type);
+    CREATE INDEX IF NOT EXISTS idx_items_inode ON items(ino, dev) WHERE ino IS NOT NULL;
+    -- Not covering: a page reads its few hundred rows by rowid anyway
+    CREATE INDEX IF NOT EXISTS idx_items_children ON items(parentId, sizeBytes);
+  `)
+  if (version < 4) countChildren(db)
+  createChildCountTriggers(db)
+  createNameIndex(db)
+  db.run(`PRAGMA user_version = ${SCHEMA_VERSION}`)
+  // Give the dropped date text back to the file system
+  if (isoTimes) db.run('VACUUM')
+}
+
+/** SQL for the epoch ms of ISO-8601 text column `col`; 0 when empty or unreadable. */
+function isoToMs(col: string): string {
+  return `COALESCE(CAST(round((julianday(NULLIF(${col}, '')) - 2440587.5) * 86400000) AS INTEGER), 0)`
+}
+
+/** Version 5: replace the ISO-8601 text timestamps with epoch-ms integers. */
+function convertIsoTimes(db: any) {
+  db.run(`
+    ALTER TABLE items ADD COLUMN lastWriteMs INTEGER NOT NULL DEFAULT 0;
+    ALTER TABLE items ADD COLUMN scannedMs INTEGER NOT NULL DEFAULT 0;
+    UPDATE items SET lastWriteMs = ${isoToMs('lastWriteUtc')}, scannedMs = ${isoToMs('scannedUtc')};
+    ALTER TABLE items DROP COLUMN lastWriteUtc;
+    ALTER TABLE items DROP COLUMN scannedUtc;
+  `)
+}
+
+/** Fill childCount / childFolderCount of every folder row from scratch. */
+function countChildren(db: any) {
+  db.run(`
+    UPDATE items SET
+      childCount = (SELECT COUNT(*) FROM items c WHERE c.parentId = items.nodeId),
+      childFolderCount = (SELECT COUNT(*) FROM items c WHERE c.parentId = items.nodeId AND c.type = 'Folder')
+    WHERE type = 'Folder'`)
+}
+
+/**
+ * Keep each row's direct child counts current as child rows come, go, move
+ * or change type. A folder row written after its children (scans write
+ * bottom-up) counts them once on insert; see UPSERT_SQL.
+ */
+function createChildCountTriggers(db: any) {
+  db.run(`
+    CREATE TRIGGER IF NOT EXISTS items_child_insert AFTER INSERT ON items BEGIN
+      UPDATE items SET childCount = childCount + 1, childFolderCount = childFolderCount + (NEW.type = 'Folder')
+      WHERE nodeId = NEW.parentId;
+    END;
+    CREATE TRIGGER IF NOT EXISTS items_child_delete AFTER DELETE ON items BEGIN
+      UPDATE items SET childCount = childCount - 1, childFolderCount = childFolderCount - (OLD.type = 'Folder')
+      WHERE nodeId = OLD.parentId;
+    END;
+    CREATE TRIGGER IF NOT EXISTS items_child_update AFTER UPDATE OF parentId, type ON items
+    WHEN OLD.parentId IS NOT NEW.parentId OR OLD.type IS NOT NEW.type BEGIN
+      UPDATE items SET childCount = childCount - 1, childFolderCount = childFolderCount - (OLD.type = 'Folder')
+      WHERE nodeId = OLD.parentId;
+      UPDATE items SET childCount = childCount + 1, childFolderCount = childFolderCount + (NEW.type = 'Folder')
+      WHERE nodeId = NEW.parentId;
+    END;
   `)
 }
 
+/** Handles whose `node_names` trigram index is present and kept current. */
+const nameIndexes = new WeakSet<object>()
+/** Per handle, the first node id created since names were last indexed. */
+const unindexedFrom = new WeakMap<object, number>()
+
+function hasSchemaObject(db: any, type: 'table' | 'trigger', name: string): boolean {
+  const stmt = db.prepare('SELECT 1 FROM sqlite_master WHERE type = ? AND name = ?')
+  stmt.bind([type, name])
+  const found = stmt.step()
+  stmt.free()
+  return found
+}
+
+/**
+ * Index node names by trigram (FTS5) for name search; see searchNames().
+ * Triggers carry deletes and renames over. New nodes are added in bulk by
+ * indexNewNames() instead: FTS5 flushes its pending terms at every
+ * statement boundary, so a trigger per inserted node would write one index
+ * segment per row. Engines built without FTS5, like stock sql.js, search by
+ * scanning: they drop the triggers they could not run, and the next engine
+ * with FTS5 rebuilds the index from `nodes`.
+ */
+function createNameIndex(db: any) {
+  unindexedFrom.delete(db)
+  const probe = db.prepare("SELECT sqlite_compileoption_used('ENABLE_FTS5') AS fts5")
+  const fts5 = probe.step() && Number(probe.getAsObject().fts5) === 1
+  probe.free()
+  if (!fts5) {
+    db.run(`
+      DROP TRIGGER IF EXISTS node_names_delete;
+      DROP TRIGGER IF EXISTS node_names_update;
+    `)
+    return
+  }
+  if (!hasSchemaObject(db, 'table', 'node_names')) {
+    db.run(`CREATE VIRTUAL TABLE node_names USING fts5(
+      name, content = 'nodes', content_rowid = 'id', tokenize = 'trigram', detail = 'none', columnsize = 0)`)
+  }
+  if (!hasSchemaObject(db, 'trigger', 'node_names_delete')) {
+    db.run(`
+      INSERT INTO node_names (node_names) VALUES ('rebuild');
+      CREATE TRIGGER IF NOT EXISTS node_names_delete AFTER DELETE ON nodes BEGIN
+        INSERT INTO node_names (node_names, rowid, name) VALUES ('delete', OLD.id, OLD.name);
+      END;
+      CREATE TRIGGER IF NOT EXISTS node_names_update AFTER UPDATE OF name ON nodes BEGIN
+        INSERT INTO node_names (node_names, rowid, name) VALUES ('delete', OLD.id, OLD.name);
+        INSERT INTO node_names (rowid, name) VALUES (NEW.id, NEW.name);
+      END;
+    `)
+  }
+  nameIndexes.add(db)
+}
+
+/**
+ * Add the nodes created since the last call to `node_names`, in one
+ * statement. New nodes always get ids above every existing one, so they
+ * are exactly those from the first id created on. Runs before a commit and
+ * before nodes are deleted or renamed, whose triggers expect them indexed.
+ */
+function indexNewNames(db: any) {
+  const from = unindexedFrom.get(db)
+  if (from === undefined) return
+  unindexedFrom.delete(db)
+  if (nameIndexes.has(db)) {
+    db.run('INSERT INTO node_names (rowid, name) SELECT id, name FROM nodes WHERE id >= :from', { ':from': from })
+  }
+}
+
+/** Move every row of the path-keyed `items_v1` table into nodes + items. */
+function migratePathRows(db: any) {
+  const cols = tableColumns(db, 'items_v1')
+  const old = db.prepare(`SELECT path, type, sizeBytes, fileCount, folderCount,
+    ${isoToMs('lastWriteUtc')} AS lastWriteMs, ${isoToMs('scannedUtc')} AS scannedMs, depth, runId,
+    ${cols.has('ino') ? 'dev, ino, dirMtimeMs' : 'NULL AS dev, NULL AS ino, NULL AS dirMtimeMs'} FROM items_v1`)
+  const insert = db.prepare(`INSERT OR REPLACE INTO items
+    (nodeId, type, sizeBytes, fileCount, folderCount, lastWriteMs, scannedMs, depth, runId, dev, ino, dirMtimeMs)
+    VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)`)
+  const nodes = new NodeResolver(db, true)
+  db.run('BEGIN')
+  while (old.step()) {
+    const r = old.getAsObject() as Record<string, any>
+    insert.run([nodes.idOf(r.path), r.type, r.sizeBytes, r.fileCount, r.folderCount, r.lastWriteMs,
+      r.scannedMs, r.depth, r.runId, r.dev, r.ino, r.dirMtimeMs])
+  }
+  db.run('COMMIT')
+  nodes.free()
+  insert.free()
+  old.free()
+  db.run('DROP TABLE items_v1')
+  // Hand the space the path strings took back to the file system
+  db.run('VACUUM')
+}
+
+/**
+ * Seed `roots` from the rows the root view used to find by scanning the
+ * whole table: volume roots, and rows whose parent has none.
+ */
+function adoptOrphanRoots(db: any) {
+  db.run(`
+    INSERT OR IGNORE INTO roots (nodeId)
+    SELECT n.id FROM nodes n JOIN items i ON i.nodeId = n.id
+    WHERE n.parentId = 0 OR NOT EXISTS (SELECT 1 FROM items p WHERE p.nodeId = n.parentId)`)
+}
+
+/* ============================================================
+   Statement cache — compile each query once per handle
+   ============================================================ */
+
+/** Prepared statements by SQL text, per database handle. */
+const statementCaches = new WeakMap<object, Map<string, any>>()
+
+/** `LFB_STMT_CACHE=0` prepares per call again, for comparison. */
+const cacheStatements = process.env.LFB_STMT_CACHE !== '0'
+
+/**
+ * A prepared statement for `sql`, compiled on first use and kept until
+ * finalizeStatements(). Hand it back with release() before anything else
+ * may use the same SQL; callers must not nest uses of one query.
+ */
+function statement(db: any, sql: string): any {
+  if (!cacheStatements) return db.prepare(sql)
+  let cache = statementCaches.get(db)
+  if (!cache) {
+    cache = new Map()
+    statementCaches.set(db, cache)
+  }
+  let stmt = cache.get(sql)
+  if (!stmt) {
+    stmt = db.prepare(sql)
+    cache.set(sql, stmt)
+  }
+  return stmt
+}
+
+/** Done with a statement from statement(): close its cursor (or free it when uncached). */
+function release(stmt: any) {
+  if (cacheStatements) stmt.reset()
+  else stmt.free()
+}
+
+/**
+ * Free every cached statement of `db`. Needed before close, before a reset
+ * drops the tables, and before sql.js export(), which frees them behind
+ * our back.
+ */
+function finalizeStatements(db: any) {
+  const cache = statementCaches.get(db)
+  if (!cache) return
+  for (const stmt of cache.values()) stmt.free()
+  statementCaches.delete(db)
+}
+
+/* ============================================================
+   Path tree — full paths ⇄ node ids
+   ============================================================ */
+
+/** Path → node id of recently resolved paths, per database handle. */
+const pathCaches = new WeakMap<object, Map<string, number>>()
+const PATH_CACHE_LIMIT = 200_000
+
+function pathCache(db: any): Map<string, number> {
+  let cache = pathCaches.get(db)
+  if (!cache) {
+    cache = new Map()
+    pathCaches.set(db, cache)
+  }
+  return cache
+}
+
+/** Forget cached ids after nodes were moved or deleted. */
+function forgetPaths(db: any) {
+  pathCaches.get(db)?.clear()
+}
+
+/** Returns the path's parent, or null for a volume root. */
+function parentPath(p: string): string | null {
+  const d = path.dirname(p)
+  return d === p ? null : d
+}
+
+/** `parent` joined with one more path component. */
+function childPath(parent: string, name: string): string {
+  return parent.endsWith(path.sep) ? parent + name : parent + path.sep + name
+}
+
+/**
+ * Resolves full paths to node ids by walking (parentId, name) from the
+ * volume root, which is stored as a node named e.g. `C:\` with parentId 0.
+ * With `create`, missing nodes are added on the way. Borrows cached
+ * statements until free().
+ */
+class NodeResolver {
+  private readonly cache: Map<string, number>
+  private readonly find: any
+  private readonly insert: any
+  private readonly adoptRoot: any
+
+  constructor(private readonly db: any, private readonly create: boolean) {
+    this.cache = pathCache(db)
+    this.find = statement(db, 'SELECT id FROM nodes WHERE parentId = ? AND name = ?')
+    this.insert = create
+      ? statement(db, 'INSERT INTO nodes (parentId, rootId, name) VALUES (?, COALESCE((SELECT rootId FROM nodes WHERE id = ?), 0), ?) RETURNING id')
+      : null
+    this.adoptRoot = create ? statement(db, 'UPDATE nodes SET rootId = id WHERE id = ?') : null
+  }
+
+  idOf(p: string): number | null {
+    const hit = this.cache.get(p)
+    if (hit !== undefined) return hit
+    const parent = parentPath(p)
+    const parentId = parent === null ? 0 : this.idOf(parent)
+    if (parentId === null) return null
+    const id = this.childId(parentId, parent === null ? p : path.basename(p))
+    if (id !== null) {
+      if (this.cache.size >= PATH_CACHE_LIMIT) this.cache.clear()
+      this.cache.set(p, id)
+    }
+    return id
+  }
+
+  /** Id of `name` below `parentId` (0 = a volume root); not cached. */
+  childId(parentId: number, name: string): number | null {
+    this.find.bind([parentId, name])
+    let id: number | null = this.find.step() ? Number(this.find.getAsObject().id) : null
+    this.find.reset()
+    if (id === null && this.create) {
+      this.insert.bind([parentId, parentId, name])
+      this.insert.step()
+      id = Number(this.insert.getAsObject().id)
+      this.insert.reset()
+      if (parentId === 0) this.adoptRoot.run([id])
+      if (!unindexedFrom.has(this.db)) unindexedFrom.set(this.db, id)
+    }
+    return id
+  }
+
+  free() {
+    indexNewNames(this.db)
+    release(this.find)
+    if (this.insert) release(this.insert)
+    if (this.adoptRoot) release(this.adoptRoot)
+  }
+}
+
+/** Node id of `p` without creating anything; null when it is not in the DB. */
+function lookupNode(db: any, p: string): number | null {
+  const nodes = new NodeResolver(db, false)
+  const id = nodes.idOf(p)
+  nodes.free()
+  return id
+}
+
+/** Full paths of the given node ids, rebuilt by walking up the tree. */
+function pathsOf(db: any, ids: number[]): Map<number, string> {
+  const known = new Map<number, string>()
+  const up = statement(db, 'SELECT parentId, name FROM nodes WHERE id = ?')
+  const resolve = (id: number): string => {
+    const hit = known.get(id)
+    if (hit !== undefined) return hit
+    up.bind([id])
+    const row = up.step() ? (up.getAsObject() as { parentId: number; name: string }) : { parentId: 0, name: '' }
+    up.reset()
+    const p = row.parentId === 0 ? row.name : childPath(resolve(row.parentId), row.name)
+    known.set(id, p)
+    return p
+  }
+  for (const id of ids) resolve(id)
+  release(up)
+  return known
+}
+
+/** An items row (plus its node id) in the shape the UI and scanner use. */
+function toRecord(row: Record<string, any>, p: string): ItemRecord {
+  return {
+    path: p,
+    parent: parentPath(p),
+    type: row.type,
+    sizeBytes: row.sizeBytes,
+    fileCount: row.fileCount,
+    folderCount: row.folderCount,
+    lastWriteMs: row.lastWriteMs,
+    scannedMs: row.scannedMs,
+    depth: row.depth,
+    runId: row.runId,
+    dev: row.dev,
+    ino: row.ino,
+    dirMtimeMs: row.dirMtimeMs
+  }
+}
+
+/** Rows carrying `nodeId`, turned into records with their full paths. */
+export function withPaths(db: any, rows: Record<string, any>[]): ItemRecord[] {
+  const paths = pathsOf(db, rows.map((r) => r.nodeId))
+  return rows.map((r) => toRecord(r, paths.get(r.nodeId)!))
+}
+
+/** The database file plus its WAL and page-journal side files. */
+function removeDatabaseFiles(dbPath: string) {
+  for (const f of [dbPath, `${dbPath}-wal`, `${dbPath}-shm`, `${dbPath}-pj`]) {
+    try {
+      fs.unlinkSync(f)
+    } catch {
+      // ignore
+    }
+  }
+}
+
+/**
+ * Open the database at `dbPath`. Uses the native node:sqlite engine, which
+ * works on the file directly in WAL mode, when the runtime provides it;
+ * otherwise loads the whole file into sql.js.
+ */
 export async function openDatabase(dbPath = defaultDbPath) {
-  await loadSql()
+  const sqlite = nativeSqlite()
+  if (!sqlite) await loadSql()
   const dir = path.dirname(dbPath)
   if (!fs.existsSync(dir)) {
     fs.mkdirSync(dir, { recursive: true })
   }
+  // Finish a page-journal save a crash interrupted
+  recoverJournal(dbPath)
 
   const loadDb = () => {
+    if (sqlite) return new NativeDatabase(dbPath, sqlite)
     if (fs.existsSync(dbPath)) {
       const data = fs.readFileSync(dbPath)
       return new SQL.Database(new Uint8Array(data))
@@ -84,17 +552,18 @@ export async function openDatabase(dbPath = defaultDbPath) {
   try {
     applySchema(db)
     // sanity check schema
-    const probe = db.prepare('SELECT path, type, sizeBytes FROM items LIMIT 1')
-    if (probe.step()) {
-      const row = probe.getAsObject() as Record<string, any>
-      if (typeof row.type !== 'string' || row.type.length === 0) {
-        throw new Error('invalid type column')
-      }
+    const probe = db.prepare('SELECT type, sizeBytes FROM items LIMIT 1')
+    const row = probe.step() ? (probe.getAsObject() as Record<string, any>) : null
+    probe.free()
+    if (row && (typeof row.type !== 'string' || row.type.length === 0)) {
+      throw new Error('invalid type column')
     }
   } catch {
     // reset corrupted/old DB
+    finalizeStatements(db)
     db.close()
-    db = new SQL.Database()
+    if (sqlite) removeDatabaseFiles(dbPath)
+    db = sqlite ? new NativeDatabase(dbPath, sqlite) : new SQL.Database()
     applySchema(db)
     needsPersist = true
   }
@@ -106,113 +575,1414 @@ export async function openDatabase(dbPath = defaultDbPath) {
   return { db, dbPath }
 }
 
-export async function resetDatabase(dbPath = defaultDbPath) {
-  if (fs.existsSync(dbPath)) {
-    try {
-      fs.unlinkSync(dbPath)
-    } catch {
-      // ignore
-    }
+/**
+ * Start over with an empty database. A native `db` is emptied in place, so
+ * the handle stays valid for anything still holding it (and the open file
+ * need not be deleted, which Windows would refuse).
+ */
+export async function resetDatabase(dbPath = defaultDbPath, db?: any) {
+  if (db?.native) {
+    // Virtual tables first; dropping one drops its shadow tables with it
+    const tables = db.prepare(`SELECT name FROM sqlite_master WHERE type = 'table' AND name NOT LIKE 'sqlite_%'
+      ORDER BY sql LIKE 'CREATE VIRTUAL%' DESC`)
+    const names: string[] = []
+    while (tables.step()) names.push(String(tables.getAsObject().name))
+    tables.free()
+    writeQueues.get(db)?.discard()
+    finalizeStatements(db)
+    for (const name of names) db.run(`DROP TABLE IF EXISTS "${name}"`)
+    db.run('VACUUM')
+    forgetPaths(db)
+    applySchema(db)
+    return { db, dbPath }
+  }
+  // The old handle is dropped, not closed: a running scan may still hold it
+  if (db) {
+    writeQueues.get(db)?.discard()
+    finalizeStatements(db)
   }
+  // Let a save still in flight land before the files go
+  await whenPersisted(dbPath)
+  removeDatabaseFiles(dbPath)
   return openDatabase(dbPath)
 }
 
 export function persistDatabase(db: any, dbPath: string) {
-  const data: Uint8Array = db.export()
-  fs.writeFileSync(dbPath, data)
-  // Buffer will be GC'd when function returns and reference goes out of scope
+  flushWrites(db)
+  // Native databases are written as each transaction commits
+  if (db.native) {
+    db.checkpoint()
+    markPersisted(dbPath)
+    return
+  }
+  // sql.js can only hand out the whole image; a background writer saves
+  // its changed pages while the caller carries on. export() frees every
+  // prepared statement, so drop the cached ones first.
+  persistImage(dbPath, () => {
+    finalizeStatements(db)
+    return db.export()
+  })
 }
 
-export function upsertItems(db: any, dbPath: string, items: ItemRecord[], persist = true) {
-  const valid = items.filter((it) => it.type === 'File' || it.type === 'Folder')
-  if (valid.length === 0) return
-
-  const stmt = db.prepare(
-    `INSERT INTO items (path, parent, type, sizeBytes, fileCount, folderCount, lastWriteUtc, scannedUtc, depth, runId)
-     VALUES (:path, :parent, :type, :sizeBytes, :fileCount, :folderCount, :lastWriteUtc, :scannedUtc, :depth, :runId)
-     ON CONFLICT(path) DO UPDATE SET
-      parent=excluded.parent,
-      type=excluded.type,
-      sizeBytes=excluded.sizeBytes,
-      fileCount=excluded.fileCount,
-      folderCount=excluded.folderCount,
-      lastWriteUtc=excluded.lastWriteUtc,
-      scannedUtc=CASE WHEN excluded.scannedUtc = '' THEN items.scannedUtc ELSE excluded.scannedUtc END,
-      depth=excluded.depth,
-      runId=excluded.runId;`
-  )
+/** Write out `db`, wait until it is on disk, and close the handle. */
+export async function closeDatabase(db: any, dbPath: string) {
+  persistDatabase(db, dbPath)
+  await whenPersisted(dbPath)
+  writeQueues.get(db)?.discard()
+  finalizeStatements(db)
+  forgetPaths(db)
+  db.close()
+}
+
+/** Remove the files of a database that is not open. */
+export function deleteDatabase(dbPath: string) {
+  removeDatabaseFiles(dbPath)
+}
+
+/** Aggregated totals of a folder row. */
+export interface FolderTotals {
+  sizeBytes: number
+  fileCount: number
+  folderCount: number
+  latestMs: number
+}
+
+/** Rows per ItemBatch before the owner must flush it. */
+const BATCH_CAPACITY = 4096
+
+/**
+ * Struct-of-arrays row buffer for bulk upserts. Scanners fill it with
+ * primitives (timestamps as epoch ms) and reuse it across flushes, so the
+ * hot loop allocates nothing per entry beyond the path string.
+ */
+export class ItemBatch {
+  length = 0
+  readonly capacity: number
+  readonly paths: string[]
+  readonly parents: (string | null)[]
+  readonly runIds: string[]
+  readonly isFolder: Uint8Array
+  readonly sizes: Float64Array
+  readonly fileCounts: Float64Array
+  readonly folderCounts: Float64Array
+  readonly lastWriteMs: Float64Array
+  /** 1 = fully scanned now; 0 = keep the row's previous scannedMs. */
+  readonly complete: Uint8Array
+  /** 1 = the folder was listed in full; drop its child rows of other runs. */
+  readonly sweep: Uint8Array
+  readonly depths: Int32Array
+  readonly devs: (string | null)[]
+  readonly inos: (string | null)[]
+  /** NaN when unknown. */
+  readonly dirMtimeMs: Float64Array
+
+  constructor(capacity = BATCH_CAPACITY) {
+    this.capacity = capacity
+    this.paths = new Array(capacity)
+    this.parents = new Array(capacity)
+    this.runIds = new Array(capacity)
+    this.isFolder = new Uint8Array(capacity)
+    this.sizes = new Float64Array(capacity)
+    this.fileCounts = new Float64Array(capacity)
+    this.folderCounts = new Float64Array(capacity)
+    this.lastWriteMs = new Float64Array(capacity)
+    this.complete = new Uint8Array(capacity)
+    this.sweep = new Uint8Array(capacity)
+    this.depths = new Int32Array(capacity)
+    this.devs = new Array(capacity)
+    this.inos = new Array(capacity)
+    this.dirMtimeMs = new Float64Array(capacity)
+  }
+
+  get full(): boolean {
+    return this.length >= this.capacity
+  }
+
+  pushFile(p: string, parent: string | null, depth: number, runId: string, sizeBytes: number, mtimeMs: number, complete: boolean) {
+    const i = this.length++
+    this.paths[i] = p
+    this.parents[i] = parent
+    this.runIds[i] = runId
+    this.isFolder[i] = 0
+    this.sizes[i] = sizeBytes
+    this.fileCounts[i] = 1
+    this.folderCounts[i] = 0
+    this.lastWriteMs[i] = Math.floor(mtimeMs)
+    this.complete[i] = complete ? 1 : 0
+    this.sweep[i] = 0
+    this.depths[i] = depth
+    this.devs[i] = null
+    this.inos[i] = null
+    this.dirMtimeMs[i] = NaN
+  }
+
+  pushFolder(
+    p: string,
+    parent: string | null,
+    depth: number,
+    runId: string,
+    totals: FolderTotals,
+    complete: boolean,
+    id: FsIdStat | null,
+    sweep = false
+  ) {
+    const i = this.length++
+    this.paths[i] = p
+    this.parents[i] = parent
+    this.runIds[i] = runId
+    this.isFolder[i] = 1
+    this.sizes[i] = totals.sizeBytes
+    this.fileCounts[i] = totals.fileCount
+    this.folderCounts[i] = totals.folderCount
+    this.lastWriteMs[i] = Math.floor(totals.latestMs || Date.now())
+    this.complete[i] = complete ? 1 : 0
+    this.sweep[i] = sweep ? 1 : 0
+    this.depths[i] = depth
+    this.devs[i] = id ? String(id.dev) : null
+    this.inos[i] = id ? String(id.ino) : null
+    this.dirMtimeMs[i] = id ? Number(id.mtimeMs) : NaN
+  }
+
+  /** Append rows of `src` starting at `from` until this batch is full; returns how many were copied. */
+  copyFrom(src: ItemBatch, from: number): number {
+    const n = Math.min(src.length - from, this.capacity - this.length)
+    const at = this.length
+    for (let k = 0; k < n; k++) {
+      this.paths[at + k] = src.paths[from + k]
+      this.parents[at + k] = src.parents[from + k]
+      this.runIds[at + k] = src.runIds[from + k]
+      this.devs[at + k] = src.devs[from + k]
+      this.inos[at + k] = src.inos[from + k]
+    }
+    this.isFolder.set(src.isFolder.subarray(from, from + n), at)
+    this.sizes.set(src.sizes.subarray(from, from + n), at)
+    this.fileCounts.set(src.fileCounts.subarray(from, from + n), at)
+    this.folderCounts.set(src.folderCounts.subarray(from, from + n), at)
+    this.lastWriteMs.set(src.lastWriteMs.subarray(from, from + n), at)
+    this.complete.set(src.complete.subarray(from, from + n), at)
+    this.sweep.set(src.sweep.subarray(from, from + n), at)
+    this.depths.set(src.depths.subarray(from, from + n), at)
+    this.dirMtimeMs.set(src.dirMtimeMs.subarray(from, from + n), at)
+    this.length += n
+    return n
+  }
+}
+
+const UPSERT_SQL = `
+  INSERT INTO items (nodeId, type, sizeBytes, fileCount, folderCount, lastWriteMs, scannedMs, depth, runId, dev, ino, dirMtimeMs,
+    parentId, childCount, childFolderCount)
+  VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13,
+    CASE WHEN ?2 = 'Folder' THEN (SELECT COUNT(*) FROM items c WHERE c.parentId = ?1) ELSE 0 END,
+    CASE WHEN ?2 = 'Folder' THEN (SELECT COUNT(*) FROM items c WHERE c.parentId = ?1 AND c.type = 'Folder') ELSE 0 END)
+  ON CONFLICT(nodeId) DO UPDATE SET
+    parentId=excluded.parentId,
+    type=excluded.type,
+    sizeBytes=excluded.sizeBytes,
+    fileCount=excluded.fileCount,
+    folderCount=excluded.folderCount,
+    lastWriteMs=excluded.lastWriteMs,
+    scannedMs=CASE WHEN excluded.scannedMs = 0 THEN items.scannedMs ELSE excluded.scannedMs END,
+    depth=excluded.depth,
+    runId=excluded.runId,
+    dev=COALESCE(excluded.dev, items.dev),
+    ino=COALESCE(excluded.ino, items.ino),
+    dirMtimeMs=COALESCE(excluded.dirMtimeMs, items.dirMtimeMs);`
+
+/** Positional parameter slots, refilled for every row. */
+const upsertRow: any[] = new Array(13)
+
+/** Child rows one run has written below a parent so far (NaN once two runs did). */
+interface ChildTally {
+  runId: string
+  rows: number
+}
+
+/**
+ * Delete the child rows of node `parentId` that run `runId` did not write,
+ * with everything below them: the folder was just listed in full, so they
+ * are gone from disk. When the run wrote as many rows as the folder's
+ * childCount there is nothing to find, which keeps the common case at one
+ * primary-key read however large the folder; the rest is set-based through
+ * the `swept` scratch table. Returns whether anything was deleted.
+ */
+function sweepChildren(db: any, parentId: number, runId: string, written: number): boolean {
+  const count = statement(db, 'SELECT childCount FROM items WHERE nodeId = ?')
+  count.bind([parentId])
+  const children = count.step() ? Number(count.getAsObject().childCount) : 0
+  release(count)
+  if (children === written) return false
+  indexNewNames(db)
+  db.run(`
+    WITH RECURSIVE sub(id) AS (
+      SELECT nodeId FROM items WHERE parentId = :parentId AND runId <> :runId
+      UNION ALL
+      SELECT n.id FROM nodes n JOIN sub ON n.parentId = sub.id
+    )
+    INSERT OR IGNORE INTO swept SELECT id FROM sub`, { ':parentId': parentId, ':runId': runId })
+  deleteSwept(db)
+  return true
+}
+
+/** Delete the nodes listed in `swept` and their rows, then empty it. */
+function deleteSwept(db: any) {
+  buryHistory(db)
+  db.run(`
+    DELETE FROM items WHERE nodeId IN swept;
+    DELETE FROM roots WHERE nodeId IN swept;
+    DELETE FROM snapshot_deltas WHERE nodeId IN swept;
+    DELETE FROM nodes WHERE id IN swept;
+    DELETE FROM swept;
+  `)
+}
+
+/**
+ * Write every row of `batches`, in order, in one transaction. `tally`
+ * counts child rows per parent across commits until the parent's own row
+ * is written.
+ */
+function writeBatches(db: any, batches: ItemBatch[], tally: Map<number, ChildTally>) {
+  const stmt = statement(db, UPSERT_SQL)
+  const nodes = new NodeResolver(db, true)
+  const row = upsertRow
+  const now = Date.now()
+  let swept = false
   db.run('BEGIN')
-  for (const item of valid) {
-    stmt.run(sqlBind(item as any))
+  try {
+    for (const batch of batches) {
+      for (let i = 0; i < batch.length; i++) {
+        const p = batch.paths[i]
+        const parent = batch.parents[i]
+        // Folders get cached as parents of later rows; files are leaves
+        const parentId = parent === null ? 0 : nodes.idOf(parent)!
+        row[0] = parent === null ? nodes.idOf(p) : nodes.childId(parentId, path.basename(p))
+        row[1] = batch.isFolder[i] ? 'Folder' : 'File'
+        row[2] = batch.sizes[i]
+        row[3] = batch.fileCounts[i]
+        row[4] = batch.folderCounts[i]
+        row[5] = batch.lastWriteMs[i]
+        row[6] = batch.complete[i] ? now : 0
+        row[7] = batch.depths[i]
+        row[8] = batch.runIds[i]
+        row[9] = batch.devs[i]
+        row[10] = batch.inos[i]
+        row[11] = Number.isNaN(batch.dirMtimeMs[i]) ? null : batch.dirMtimeMs[i]
+        row[12] = parentId
+        stmt.run(row)
+        const runId = row[8]
+        const t = tally.get(parentId)
+        if (!t) tally.set(parentId, { runId, rows: 1 })
+        else if (t.runId === runId) t.rows++
+        else t.rows = NaN
+        if (!batch.isFolder[i]) continue
+        // A folder's row follows all of its children's, so they are in by now
+        const own = tally.get(row[0])
+        tally.delete(row[0])
+        const written = !own ? 0 : own.runId === runId ? own.rows : NaN
+        if (batch.sweep[i] && sweepChildren(db, row[0], runId, written)) swept = true
+      }
+    }
+    indexNewNames(db)
+    db.run('COMMIT')
+    if (swept) forgetPaths(db)
+  } catch (err) {
+    db.run('ROLLBACK')
+    // Node ids resolved inside the rolled-back transaction are gone, and
+    // so are the rows counted; a short tally only costs a sweep that finds nothing
+    tally.clear()
+    forgetPaths(db)
+    throw err
+  } finally {
+    nodes.free()
+    release(stmt)
   }
-  db.run('COMMIT')
-  if (persist) persistDatabase(db, dbPath)
 }
 
-export function getChildren(db: any, parent: string | null, limit = 200, offset = 0, sort: 'size_desc' | 'name_asc' = 'size_desc', includeFiles = true) {
-  const sortClause = sort === 'name_asc' ? 'ORDER BY path ASC' : 'ORDER BY sizeBytes DESC'
-  const typeFilter = includeFiles ? '' : "AND type = 'Folder'"
-  const paramName = parent ? ':parent' : null
-  const where = parent ? `parent = ${paramName}` : 'parent IS NULL'
-  const query = `SELECT * FROM items WHERE ${where} ${typeFilter} ${sortClause} LIMIT :limit OFFSET :offset`
-  const stmt = db.prepare(query)
+/* ============================================================
+   Write-behind queue — one writer per handle, large transactions
+   ============================================================ */
+
+/** Commit as soon as this many rows are queued; producers past it wait for the commit. */
+const QUEUE_COMMIT_ROWS = 32_768
+/** Otherwise commit this long (ms) after the first row was queued. */
+const QUEUE_COMMIT_MS = 250
+/** Emptied batches kept for reuse per queue. */
+const SPARE_BATCHES = 8
+
+/**
+ * Every row written to a handle goes through its queue, which gathers
+ * the rows of all scans into one transaction per QUEUE_COMMIT_ROWS rows or
+ * QUEUE_COMMIT_MS. Reads that must see them call flushWrites() first.
+ * A commit the timer ran that fails is thrown to the next add() or
+ * commit(), so the scan whose rows were lost fails with it.
+ */
+class WriteQueue {
+  /** Rows not yet written; only the last batch may still be filling. */
+  private readonly pending: ItemBatch[] = []
+  private readonly spare: ItemBatch[] = []
+  /** Child rows written per parent node id whose own row has not come yet. */
+  private readonly tally = new Map<number, ChildTally>()
+  private rows = 0
+  /** Some caller asked for the rows to be saved once written. */
+  private persist = false
+  private timer: ReturnType<typeof setTimeout> | null = null
+  /** Error of the last timed commit, not yet handed to a caller. */
+  private failed: unknown = null
+
+  constructor(readonly db: any, readonly dbPath: string) {}
+
+  /** Throw the error of a failed timed commit, once. */
+  private rethrow() {
+    if (this.failed === null) return
+    const err = this.failed
+    this.failed = null
+    throw err
+  }
+
+  /** Copy the rows of `batch` into the queue and empty it for reuse. */
+  add(batch: ItemBatch, persist: boolean) {
+    this.rethrow()
+    for (let i = 0; i < batch.length;) {
+      let tail = this.pending[this.pending.length - 1]
+      if (!tail || tail.full) {
+        tail = this.spare.pop() ?? new ItemBatch()
+        this.pending.push(tail)
+      }
+      i += tail.copyFrom(batch, i)
+    }
+    this.rows += batch.length
+    this.persist ||= persist
+    batch.length = 0
+    if (this.rows === 0) return
+    queuesWithRows.add(this)
+    // Backpressure: a producer that outruns the timer pays for the commit
+    if (this.rows >= QUEUE_COMMIT_ROWS) {
+      this.commit()
+    } else if (!this.timer) {
+      this.timer = setTimeout(() => {
+        this.timer = null
+        try {
+          this.commit()
+        } catch (err) {
+          this.failed = err
+        }
+      }, QUEUE_COMMIT_MS)
+      this.timer.unref?.()
+    }
+  }
+
+  /** Write everything queued now, in one transaction. */
+  commit() {
+    if (this.timer) {
+      clearTimeout(this.timer)
+      this.timer = null
+    }
+    this.rethrow()
+    queuesWithRows.delete(this)
+    if (this.rows === 0) return
+    const batches = this.pending.splice(0)
+    const persist = this.persist
+    this.rows = 0
+    this.persist = false
+    try {
+      writeBatches(this.db, batches, this.tally)
+    } finally {
+      for (const b of batches) {
+        b.length = 0
+        if (this.spare.length < SPARE_BATCHES) this.spare.push(b)
+      }
+    }
+    if (persist) persistDatabase(this.db, this.dbPath)
+  }
+
+  /** Drop everything queued (the database is being reset). */
+  discard() {
+    if (this.timer) clearTimeout(this.timer)
+    this.timer = null
+    queuesWithRows.delete(this)
+    this.pending.length = 0
+    this.tally.clear()
+    this.rows = 0
+    this.persist = false
+    this.failed = null
+  }
+}
+
+const writeQueues = new WeakMap<object, WriteQueue>()
+/** Queues holding rows, so quitting can flush them; emptied queues leave. */
+const queuesWithRows = new Set<WriteQueue>()
+
+function writeQueue(db: any, dbPath: string): WriteQueue {
+  let q = writeQueues.get(db)
+  if (!q) {
+    q = new WriteQueue(db, dbPath)
+    writeQueues.set(db, q)
+  }
+  return q
+}
+
+/**
+ * Commit the rows queued for `db` so the next statement sees them. Throws
+ * what a timed commit of the queue ran into since the last call.
+ */
+export function flushWrites(db: any) {
+  writeQueues.get(db)?.commit()
+}
+
+/**
+ * Queue every row of `batch` for writing and empty it for reuse. The rows
+ * land within QUEUE_COMMIT_MS, together with whatever other writers queued;
+ * with `persist` the database is saved after that commit.
+ */
+export function upsertBatch(db: any, dbPath: string, batch: ItemBatch, persist = false) {
+  if (batch.length === 0) return
+  writeQueue(db, dbPath).add(batch, persist)
+}
+
+/** Write out the rows queued for `db`, save it, and resolve once that is on disk. */
+export function whenDurable(db: any, dbPath: string): Promise<void> {
+  persistDatabase(db, dbPath)
+  return whenPersisted(dbPath)
+}
+
+/** whenDurable() for every handle that still has rows queued — for quitting. */
+export function whenAllDurable(): Promise<void> {
+  for (const q of [...queuesWithRows]) {
+    try {
+      persistDatabase(q.db, q.dbPath)
+    } catch (err) {
+      console.error(`Writing scan results to ${q.dbPath} failed:`, err)
+    }
+  }
+  return whenPersisted()
+}
+
+/**
+ * Scratch buffer for upsertItems — record-based callers (shallow scans).
+ * Emptied even when a write throws, so no rows leak into the next call,
+ * which may be for another shard.
+ */
+const scratchBatch = new ItemBatch()
+
+export function upsertItems(db: any, dbPath: string, items: ItemRecord[], persist = true) {
+  try {
+    for (const it of items) {
+      if (it.type === 'File') {
+        scratchBatch.pushFile(it.path, it.parent, it.depth, it.runId, it.sizeBytes, it.lastWriteMs, it.scannedMs !== 0)
+      } else if (it.type === 'Folder') {
+        scratchBatch.pushFolder(it.path, it.parent, it.depth, it.runId, {
+          sizeBytes: it.sizeBytes,
+          fileCount: it.fileCount,
+          folderCount: it.folderCount,
+          latestMs: it.lastWriteMs
+        }, it.scannedMs !== 0, null)
+      }
+      if (scratchBatch.full) upsertBatch(db, dbPath, scratchBatch, persist)
+    }
+    upsertBatch(db, dbPath, scratchBatch, persist)
+  } finally {
+    scratchBatch.length = 0
+  }
+}
+
+/** A cursor that another sort order (or nothing) produced; paging on would loop. */
+function badCursor(cursor: string, sort: string): Error {
+  return new Error(`children: '${cursor}' is not a ${sort} cursor`)
+}
+
+/** Keyset position after the last row of a page: `s:<size>:<nodeId>` or `n:<name>`. */
+function childCursor(sort: 'size_desc' | 'name_asc', row: Record<string, any>): string {
+  return sort === 'name_asc' ? `n:${row.name}` : `s:${row.sizeBytes}:${row.nodeId}`
+}
+
+/**
+ * List the rows below `parent` a page at a time. Pass the previous page's
+ * `nextCursor` to continue right after it — an index seek however deep the
+ * page — or `offset` to skip rows the slow way. `total` is read from the
+ * parent's maintained child counts.
+ */
+export function getChildren(
+  db: any,
+  parent: string | null,
+  limit = 200,
+  offset = 0,
+  sort: 'size_desc' | 'name_asc' = 'size_desc',
+  includeFiles = true,
+  cursor?: string
+) {
+  flushWrites(db)
+  // Volume roots hang off the virtual node 0
+  const parentId = parent === null ? 0 : lookupNode(db, parent)
+  if (parentId === null) return { items: [] as ItemRecord[], total: 0 }
+  const typeFilter = includeFiles ? '' : "AND i.type = 'Folder'"
+  const params: Record<string, any> = { ':parentId': parentId, ':limit': limit, ':offset': offset }
+  let sql: string
+  if (sort === 'name_asc') {
+    // Walks the (parentId, name) unique index of nodes
+    if (cursor !== undefined && !cursor.startsWith('n:')) throw badCursor(cursor, sort)
+    const after = cursor !== undefined ? 'AND n.name > :name' : ''
+    if (after) params[':name'] = cursor!.slice(2)
+    sql = `SELECT n.name, i.* FROM nodes n CROSS JOIN items i ON i.nodeId = n.id
+      WHERE n.parentId = :parentId ${typeFilter} ${after} ORDER BY n.name LIMIT :limit OFFSET :offset`
+  } else {
+    // Walks idx_items_children backwards; nodeId (the rowid) breaks size ties
+    const m = cursor !== undefined ? /^s:(-?\d+):(\d+)$/.exec(cursor) : null
+    if (cursor !== undefined && !m) throw badCursor(cursor, sort)
+    const after = m ? 'AND (i.sizeBytes, i.nodeId) < (:size, :id)' : ''
+    if (m) {
+      params[':size'] = Number(m[1])
+      params[':id'] = Number(m[2])
+    }
+    sql = `SELECT n.name, i.* FROM items i CROSS JOIN nodes n ON n.id = i.nodeId
+      WHERE i.parentId = :parentId ${typeFilter} ${after} ORDER BY i.sizeBytes DESC, i.nodeId DESC LIMIT :limit OFFSET :offset`
+  }
+  const stmt = statement(db, sql)
   const rows = [] as ItemRecord[]
-  const bindObj: Record<string, any> = { ':limit': limit, ':offset': offset }
-  if (parent !== null) bindObj[':parent'] = parent
-  stmt.bind(bindObj)
+  let last: Record<string, any> | null = null
+  stmt.bind(params)
   while (stmt.step()) {
-    rows.push(stmt.getAsObject() as ItemRecord)
+    last = stmt.getAsObject() as Record<string, any>
+    rows.push(toRecord(last, parent === null ? last.name : childPath(parent, last.name)))
   }
-  const countBindObj: Record<string, any> = {}
-  if (parent !== null) countBindObj[':parent'] = parent
-  const countStmt = db.prepare(`SELECT COUNT(*) as cnt FROM items WHERE ${where} ${typeFilter}`)
-  countStmt.bind(countBindObj)
-  const countRow = countStmt.step() ? (countStmt.getAsObject() as any) : { cnt: 0 }
-  return { items: rows, total: countRow.cnt as number }
+  release(stmt)
+  const nextCursor = last && rows.length === limit ? childCursor(sort, last) : undefined
+  return { items: rows, total: countChildRows(db, parentId, includeFiles), nextCursor }
+}
+
+/** Rows directly below node `parentId`, from its counters when it has a row. */
+function countChildRows(db: any, parentId: number, includeFiles: boolean): number {
+  const counts = statement(db, 'SELECT childCount, childFolderCount FROM items WHERE nodeId = :id')
+  counts.bind({ ':id': parentId })
+  const row = counts.step() ? (counts.getAsObject() as any) : null
+  release(counts)
+  if (row) return includeFiles ? row.childCount : row.childFolderCount
+  // Volume roots and orphans have no parent row to hold the counts
+  const stmt = statement(db, `SELECT COUNT(*) as cnt FROM items WHERE parentId = :id ${includeFiles ? '' : "AND type = 'Folder'"}`)
+  stmt.bind({ ':id': parentId })
+  const cnt = stmt.step() ? (stmt.getAsObject() as any).cnt : 0
+  release(stmt)
+  return cnt
+}
+
+/**
+ * Remember `rootPath` as a scan root, shown in the root view while no row
+ * above it covers it. Scanners call this before writing the root's rows.
+ */
+export function registerRoot(db: any, rootPath: string) {
+  const nodes = new NodeResolver(db, true)
+  const id = nodes.idOf(rootPath)
+  nodes.free()
+  const stmt = statement(db, 'INSERT OR IGNORE INTO roots (nodeId) VALUES (?)')
+  stmt.run([id])
+  release(stmt)
+}
+
+/** Paths of every registered scan root, nested ones included. */
+export function getRootPaths(db: any): string[] {
+  const stmt = statement(db, 'SELECT nodeId FROM roots')
+  const ids: number[] = []
+  while (stmt.step()) ids.push(Number(stmt.getAsObject().nodeId))
+  release(stmt)
+  const paths = pathsOf(db, ids)
+  return ids.map((id) => paths.get(id)!)
 }
 
 export function getRoots(db: any, limit = 200, sort: 'size_desc' | 'name_asc' = 'size_desc') {
-  const sortClause = sort === 'name_asc' ? 'ORDER BY path ASC' : 'ORDER BY sizeBytes DESC'
-  // Show items whose parent is NULL (drive roots) plus orphans whose parent
-  // isn't in the DB — but only if no existing root is already an ancestor
-  // of the orphan's path (prevents deep scanned folders duplicating at root).
+  // Show volume roots plus scan roots whose parent isn't in the DB — but
+  // only if their volume root isn't in the DB either (a later scan higher
+  // up subsumes them). CROSS JOIN keeps the handful of registered roots as
+  // the outer loop instead of a walk down the size index.
+  flushWrites(db)
   const query = `
-    SELECT * FROM items
-    WHERE parent IS NULL
+    SELECT i.* FROM roots rt CROSS JOIN nodes n ON n.id = rt.nodeId CROSS JOIN items i ON i.nodeId = n.id
+    WHERE n.parentId = 0
        OR (
-         parent NOT IN (SELECT path FROM items)
-         AND NOT EXISTS (
-           SELECT 1 FROM items r
-           WHERE r.parent IS NULL
-             AND items.path LIKE r.path || '%'
-         )
+         NOT EXISTS (SELECT 1 FROM items p WHERE p.nodeId = n.parentId)
+         AND NOT EXISTS (SELECT 1 FROM items r WHERE r.nodeId = n.rootId)
        )
-    ${sortClause} LIMIT :limit`
-  const stmt = db.prepare(query)
-  const rows = [] as ItemRecord[]
-  stmt.bind({ ':limit': limit })
-  while (stmt.step()) {
-    rows.push(stmt.getAsObject() as ItemRecord)
-  }
+    ORDER BY i.sizeBytes DESC`
+  const stmt = statement(db, query)
+  const found: Record<string, any>[] = []
+  while (stmt.step()) found.push(stmt.getAsObject())
+  release(stmt)
+  let rows = withPaths(db, found)
+  if (sort === 'name_asc') rows.sort((a, b) => (a.path < b.path ? -1 : a.path > b.path ? 1 : 0))
+  rows = rows.slice(0, limit)
   return { items: rows, total: rows.length }
 }
 
 export function getTop(db: any, type: ItemType, limit = 100) {
-  const stmt = db.prepare(`SELECT * FROM items WHERE type = :type ORDER BY sizeBytes DESC LIMIT :limit`)
-  const rows = [] as ItemRecord[]
+  flushWrites(db)
+  const stmt = statement(db, 'SELECT * FROM items WHERE type = :type ORDER BY sizeBytes DESC LIMIT :limit')
+  const found: Record<string, any>[] = []
   stmt.bind({ ':type': type, ':limit': limit })
+  while (stmt.step()) found.push(stmt.getAsObject())
+  release(stmt)
+  return withPaths(db, found)
+}
+
+/**
+ * Look up a single item by path (case-sensitive). Returns null if not found.
+ * Reads committed rows only: scanners call it once per directory and ask
+ * about rows of earlier runs, so it does not flush the write queue.
+ */
+export function getItemByPath(db: any, itemPath: string): ItemRecord | null {
+  const id = lookupNode(db, itemPath)
+  if (id === null) return null
+  const stmt = statement(db, 'SELECT * FROM items WHERE nodeId = :id')
+  stmt.bind({ ':id': id })
+  const row = stmt.step() ? toRecord(stmt.getAsObject(), itemPath) : null
+  release(stmt)
+  return row
+}
+
+/**
+ * Items and bytes already known below `dirPath`, summed folder by folder:
+ * a completely scanned folder contributes its totals, an unfinished one
+ * itself plus whatever is known below it. Null when nothing is.
+ */
+export function getKnownTotals(db: any, dirPath: string): { items: number; bytes: number } | null {
+  const id = lookupNode(db, dirPath)
+  if (id === null) return null
+  const stmt = statement(db, `
+    WITH RECURSIVE open(id) AS (
+      SELECT :id
+      UNION ALL
+      SELECT i.nodeId FROM items i JOIN open ON i.parentId = open.id WHERE i.type = 'Folder' AND i.scannedMs = 0
+    )
+    SELECT
+      SUM(CASE WHEN type = 'Folder' AND scannedMs <> 0 THEN fileCount + folderCount + 1 ELSE 1 END) AS items,
+      SUM(CASE WHEN type = 'Folder' AND scannedMs = 0 THEN 0 ELSE sizeBytes END) AS bytes
+    FROM items WHERE parentId IN open`)
+  stmt.bind({ ':id': id })
+  const row = stmt.step() ? (stmt.getAsObject() as any) : null
+  release(stmt)
+  return row?.items ? { items: Number(row.items), bytes: Number(row.bytes) } : null
+}
+
+/** Find a committed folder row by filesystem identity (device + inode). */
+export function getFolderByInode(db: any, dev: string, ino: string): ItemRecord | null {
+  const stmt = statement(
+    db,
+    "SELECT * FROM items WHERE ino = :ino AND dev = :dev AND type = 'Folder' ORDER BY scannedMs DESC LIMIT 1"
+  )
+  stmt.bind({ ':ino': ino, ':dev': dev })
+  const row = stmt.step() ? stmt.getAsObject() : null
+  release(stmt)
+  return row ? withPaths(db, [row])[0] : null
+}
+
+/** Recursive CTE naming node `:id` and every node below it `sub`. */
+const SUBTREE_CTE = 'WITH RECURSIVE sub(id) AS (SELECT :id UNION ALL SELECT n.id FROM nodes n JOIN sub ON n.parentId = sub.id)'
+
+/** Delete a node, everything below it, and their rows. */
+function deleteSubtree(db: any, id: number) {
+  indexNewNames(db)
+  db.run(`${SUBTREE_CTE} INSERT OR IGNORE INTO swept SELECT id FROM sub`, { ':id': id })
+  deleteSwept(db)
+}
+
+/**
+ * Move a folder row and its whole cached subtree from `oldPath` to
+ * `newPath` by re-pointing a single node. Rows already present at the new
+ * location are replaced, and a scan root that moved stops being one.
+ */
+export function moveSubtree(db: any, oldPath: string, newPath: string, depthDelta: number) {
+  flushWrites(db)
+  const id = lookupNode(db, oldPath)
+  if (id === null) return
+  const existing = lookupNode(db, newPath)
+  if (existing !== null && existing !== id) deleteSubtree(db, existing)
+
+  const newParent = parentPath(newPath)
+  const nodes = new NodeResolver(db, true)
+  const parentId = newParent === null ? 0 : nodes.idOf(newParent)!
+  nodes.free()
+  db.run('UPDATE nodes SET parentId = :parentId, name = :name WHERE id = :id', {
+    ':parentId': parentId,
+    ':name': newParent === null ? newPath : path.basename(newPath),
+    ':id': id
+  })
+  db.run('UPDATE items SET parentId = :parentId WHERE nodeId = :id', { ':parentId': parentId, ':id': id })
+  db.run(
+    `${SUBTREE_CTE} UPDATE nodes SET rootId = COALESCE((SELECT rootId FROM nodes WHERE id = :parentId), :id) WHERE id IN sub`,
+    { ':id': id, ':parentId': parentId }
+  )
+  db.run(`${SUBTREE_CTE} UPDATE items SET depth = depth + :delta WHERE nodeId IN sub`, { ':id': id, ':delta': depthDelta })
+  // Found inside the scan that moved it, so no longer a root of its own
+  db.run('DELETE FROM roots WHERE nodeId = :id', { ':id': id })
+  forgetPaths(db)
+}
+
+/**
+ * Copy the row at `fromPath` in `src` and every row below it into `dst`
+ * at `toPath`, scan marks and identities included — how a scan takes over
+ * a subtree another database already holds instead of walking it again.
+ */
+export function copySubtree(src: any, dst: any, fromPath: string, toPath: string, depthDelta: number) {
+  flushWrites(src)
+  flushWrites(dst)
+  const id = lookupNode(src, fromPath)
+  if (id === null) return
+  const read = statement(src, `
+    WITH RECURSIVE sub(id, path) AS (
+      SELECT :id, :p
+      UNION ALL
+      SELECT n.id, sub.path || CASE WHEN substr(sub.path, -1) = :sep THEN '' ELSE :sep END || n.name
+      FROM nodes n JOIN sub ON n.parentId = sub.id
+    )
+    SELECT sub.path AS path, i.* FROM sub JOIN items i ON i.nodeId = sub.id`)
+  read.bind({ ':id': id, ':p': toPath, ':sep': path.sep })
+  const write = statement(dst, UPSERT_SQL)
+  const nodes = new NodeResolver(dst, true)
+  const row = upsertRow
+  dst.run('BEGIN')
+  try {
+    // Breadth first, so every parent's node is resolved before its children
+    while (read.step()) {
+      const r = read.getAsObject() as Record<string, any>
+      const parent = parentPath(r.path)
+      row[0] = nodes.idOf(r.path)
+      row[1] = r.type
+      row[2] = r.sizeBytes
+      row[3] = r.fileCount
+      row[4] = r.folderCount
+      row[5] = r.lastWriteMs
+      row[6] = r.scannedMs
+      row[7] = r.depth + depthDelta
+      row[8] = r.runId
+      row[9] = r.dev
+      row[10] = r.ino
+      row[11] = r.dirMtimeMs
+      row[12] = parent === null ? 0 : nodes.idOf(parent)
+      write.run(row)
+    }
+    indexNewNames(dst)
+    dst.run('COMMIT')
+  } catch (err) {
+    dst.run('ROLLBACK')
+    forgetPaths(dst)
+    throw err
+  } finally {
+    nodes.free()
+    release(write)
+    release(read)
+  }
+}
+
+/** Delete the row at `p` with everything below it, as a sweep would. */
+export function removeSubtree(db: any, p: string) {
+  flushWrites(db)
+  const id = lookupNode(db, p)
+  if (id === null) return
+  deleteSubtree(db, id)
+  forgetPaths(db)
+}
+
+/** Paths and recorded directory mtimes of every folder at or below `dirPath`. */
+export function getSubtreeFolders(db: any, dirPath: string): { path: string; dirMtimeMs: number | null }[] {
+  flushWrites(db)
+  const id = lookupNode(db, dirPath)
+  if (id === null) return []
+  const stmt = statement(db, `
+    WITH RECURSIVE sub(id, path) AS (
+      SELECT :id, :p
+      UNION ALL
+      SELECT n.id, sub.path || CASE WHEN substr(sub.path, -1) = :sep THEN '' ELSE :sep END || n.name
+      FROM nodes n JOIN sub ON n.parentId = sub.id
+      JOIN items c ON c.nodeId = n.id AND c.type = 'Folder'
+    )
+    SELECT sub.path, i.dirMtimeMs FROM sub JOIN items i ON i.nodeId = sub.id WHERE i.type = 'Folder'`)
+  stmt.bind({ ':id': id, ':p': dirPath, ':sep': path.sep })
+  const rows: { path: string; dirMtimeMs: number | null }[] = []
+  while (stmt.step()) rows.push(stmt.getAsObject() as any)
+  release(stmt)
+  return rows
+}
+
+/** Clear the scanned mark of the given paths so incremental scans revisit them. */
+export function markUnscanned(db: any, paths: string[]) {
+  flushWrites(db)
+  const stmt = statement(db, "UPDATE items SET scannedMs = 0 WHERE nodeId = :id")
+  const nodes = new NodeResolver(db, false)
+  db.run('BEGIN')
+  for (const p of paths) {
+    const id = nodes.idOf(p)
+    if (id !== null) stmt.run({ ':id': id })
+  }
+  db.run('COMMIT')
+  nodes.free()
+  release(stmt)
+}
+
+/** Delete this run's file rows (and their nodes) below the scan's final size threshold. */
+export function pruneSmallFiles(db: any, runId: string, minBytes: number) {
+  flushWrites(db)
+  const params = { ':runId': runId, ':min': minBytes }
+  const small = "SELECT nodeId FROM items WHERE type = 'File' AND runId = :runId AND sizeBytes < :min"
+  // Both or neither: a node without its row, or the reverse, would linger
+  db.run('BEGIN')
+  try {
+    db.run(`DELETE FROM nodes WHERE id IN (${small})`, params)
+    db.run(`DELETE FROM items WHERE nodeId IN (${small})`, params)
+    db.run('COMMIT')
+  } catch (err) {
+    db.run('ROLLBACK')
+    throw err
+  } finally {
+    forgetPaths(db)
+  }
+}
+
+/* ============================================================
+   Scan history — snapshots stored as deltas
+   ============================================================ */
+
+/**
+ * How long the history of a deleted folder outlives it. Until then its
+ * size at earlier snapshots and its shrinkage to nothing stay queryable.
+ */
+const HISTORY_HORIZON_MS = 180 * 24 * 60 * 60 * 1000
+
+/**
+ * Move the history of the nodes listed in `swept`, about to be deleted, to
+ * path-keyed tombstones: node ids are handed out again, paths are not
+ * ambiguous. Snapshots of a deleted root keep its path instead of its id.
+ */
+function buryHistory(db: any) {
+  const ids = allRows(db, 'SELECT DISTINCT nodeId FROM snapshot_deltas WHERE nodeId IN swept', {}).map((r) => r.nodeId)
+  if (ids.length === 0) return
+  const paths = pathsOf(db, ids)
+  const bury = statement(db, `
+    INSERT OR REPLACE INTO snapshot_tombstones (path, snapshotId, sizeBytes, fileCount, folderCount, lastSnapshotId, goneMs)
+    SELECT :path, snapshotId, sizeBytes, fileCount, folderCount, (SELECT MAX(id) FROM snapshots), :now
+    FROM snapshot_deltas WHERE nodeId = :id`)
+  const orphan = statement(db, 'UPDATE snapshots SET rootId = 0, rootPath = :path WHERE rootId = :id')
+  const now = Date.now()
+  for (const id of ids) {
+    bury.run({ ':path': paths.get(id)!, ':now': now, ':id': id })
+    orphan.run({ ':path': paths.get(id)!, ':id': id })
+  }
+  release(bury)
+  release(orphan)
+}
+
+/**
+ * Record the folder totals below `rootPath` as a new snapshot. Only
+ * folders whose size or counts differ from their latest recorded state get
+ * a `snapshot_deltas` row, so an unchanged tree costs one `snapshots` row.
+ * Tombstones past HISTORY_HORIZON_MS are dropped on the way. Returns the
+ * snapshot id, or null when the root has no row.
+ */
+export function recordSnapshot(db: any, rootPath: string, runId: string, takenMs = Date.now()): number | null {
+  flushWrites(db)
+  const rootId = lookupNode(db, rootPath)
+  if (rootId === null || !getItemByPath(db, rootPath)) return null
+  db.run('BEGIN')
+  try {
+    db.run('INSERT INTO snapshots (rootId, runId, takenMs) VALUES (:rootId, :runId, :takenMs)', {
+      ':rootId': rootId, ':runId': runId, ':takenMs': takenMs
+    })
+    const last = statement(db, 'SELECT MAX(id) AS id FROM snapshots')
+    last.step()
+    const id = Number(last.getAsObject().id)
+    release(last)
+    // Walks folder rows only, down idx_items_children
+    db.run(`
+      WITH RECURSIVE sub(id) AS (
+        SELECT :rootId
+        UNION ALL
+        SELECT i.nodeId FROM items i JOIN sub ON i.parentId = sub.id WHERE i.type = 'Folder'
+      )
+      INSERT INTO snapshot_deltas (nodeId, snapshotId, sizeBytes, fileCount, folderCount)
+      SELECT i.nodeId, :snap, i.sizeBytes, i.fileCount, i.folderCount FROM sub JOIN items i ON i.nodeId = sub.id
+      WHERE (i.sizeBytes, i.fileCount, i.folderCount) IS NOT (
+        SELECT d.sizeBytes, d.fileCount, d.folderCount FROM snapshot_deltas d
+        WHERE d.nodeId = i.nodeId ORDER BY d.snapshotId DESC LIMIT 1
+      )`, { ':rootId': rootId, ':snap': id })
+    db.run('DELETE FROM snapshot_tombstones WHERE goneMs < :horizon', { ':horizon': takenMs - HISTORY_HORIZON_MS })
+    db.run(`DELETE FROM snapshots WHERE rootId = 0
+      AND NOT EXISTS (SELECT 1 FROM snapshot_tombstones t WHERE t.path = snapshots.rootPath)`)
+    db.run('COMMIT')
+    return id
+  } catch (err) {
+    db.run('ROLLBACK')
+    throw err
+  }
+}
+
+/** Snapshots, newest first; only those of `rootPath` (deleted or not) when given. */
+export function listSnapshots(db: any, rootPath?: string): SnapshotInfo[] {
+  const found = allRows(db, `SELECT id, rootId, rootPath, runId, takenMs FROM snapshots
+    WHERE :path IS NULL OR rootId = :rootId OR (rootId = 0 AND rootPath = :path) ORDER BY id DESC`, {
+    ':path': rootPath ?? null,
+    ':rootId': rootPath === undefined ? null : lookupNode(db, rootPath)
+  })
+  const paths = pathsOf(db, found.filter((r) => r.rootId !== 0).map((r) => r.rootId))
+  return found.map((r) => ({
+    id: r.id,
+    rootPath: r.rootId === 0 ? r.rootPath : paths.get(r.rootId)!,
+    runId: r.runId,
+    takenMs: r.takenMs
+  }))
+}
+
+/** Latest recorded state of node `id` as of snapshot `snapshotId`. */
+const STATE_AT = `SELECT sizeBytes, fileCount, folderCount FROM snapshot_deltas
+  WHERE nodeId = :id AND snapshotId <= :snap ORDER BY snapshotId DESC LIMIT 1`
+
+/**
+ * Latest tombstoned state of each path matched by `where` as of snapshot
+ * `:snap`, if the folder still existed when that snapshot was taken.
+ */
+const BURIED_AT = (where: string) => `
+  SELECT path, sizeBytes, fileCount, folderCount FROM (
+    SELECT t.*, ROW_NUMBER() OVER (PARTITION BY t.path ORDER BY t.snapshotId DESC) AS newest
+    FROM snapshot_tombstones t WHERE ${where} AND t.snapshotId <= :snap
+  )
+  WHERE newest = 1 AND lastSnapshotId >= :snap`
+
+/**
+ * A folder's totals as of snapshot `snapshotId`, from its tombstone when
+ * it has since been deleted; null if it had not been recorded by then.
+ */
+export function getSizeAt(db: any, folderPath: string, snapshotId: number): FolderSizeAt | null {
+  const id = lookupNode(db, folderPath)
+  let row: Record<string, any> | undefined
+  if (id !== null) row = allRows(db, STATE_AT, { ':id': id, ':snap': snapshotId })[0]
+  // Deleted since, or deleted and created anew after the snapshot
+  row ??= allRows(db, BURIED_AT('t.path = :path'), { ':path': folderPath, ':snap': snapshotId })[0]
+  return row ? { sizeBytes: row.sizeBytes, fileCount: row.fileCount, folderCount: row.folderCount } : null
+}
+
+/**
+ * The subfolders of `parent` by how much they grew since snapshot
+ * `snapshotId`. Subfolders deleted since count as shrunk to nothing.
+ */
+export function getGrowth(db: any, parent: string, snapshotId: number, limit = 200): GrowthEntry[] {
+  flushWrites(db)
+  const parentId = lookupNode(db, parent)
+  if (parentId === null) return []
+  // Tombstones of direct children: paths in [prefix, prefix with the separator bumped)
+  const prefix = parent.endsWith(path.sep) ? parent : parent + path.sep
+  const buried = new Map<string, number>()
+  for (const r of allRows(db, BURIED_AT('t.path > :lo AND t.path < :hi'), {
+    ':lo': prefix,
+    ':hi': prefix.slice(0, -1) + String.fromCharCode(prefix.charCodeAt(prefix.length - 1) + 1),
+    ':snap': snapshotId
+  })) {
+    if (!r.path.includes(path.sep, prefix.length)) buried.set(r.path, r.sizeBytes)
+  }
+  const stmt = statement(db, `
+    SELECT n.name, i.sizeBytes, (
+      SELECT d.sizeBytes FROM snapshot_deltas d
+      WHERE d.nodeId = i.nodeId AND d.snapshotId <= :snap ORDER BY d.snapshotId DESC LIMIT 1
+    ) AS thenBytes
+    FROM items i CROSS JOIN nodes n ON n.id = i.nodeId
+    WHERE i.parentId = :parentId AND i.type = 'Folder'
+    ORDER BY i.sizeBytes - COALESCE(thenBytes, 0) DESC LIMIT :limit`)
+  const rows: GrowthEntry[] = []
+  stmt.bind({ ':snap': snapshotId, ':parentId': parentId, ':limit': limit })
   while (stmt.step()) {
-    rows.push(stmt.getAsObject() as ItemRecord)
+    const r = stmt.getAsObject() as Record<string, any>
+    const p = childPath(parent, r.name)
+    rows.push({ path: p, sizeBytes: r.sizeBytes, thenBytes: r.thenBytes ?? buried.get(p) ?? null })
+    buried.delete(p)
   }
+  release(stmt)
+  if (buried.size === 0) return rows
+  for (const [p, thenBytes] of buried) {
+    if (lookupNode(db, p) === null) rows.push({ path: p, sizeBytes: 0, thenBytes })
+  }
+  const growth = (e: GrowthEntry) => e.sizeBytes - (e.thenBytes ?? 0)
+  return rows.sort((a, b) => growth(b) - growth(a)).slice(0, limit)
+}
+
+/* ============================================================
+   Name search — LIKE over node names, by trigram index when built
+   ============================================================ */
+
+/** Node ids one searchNames() step covers, so no step blocks for long. */
+const SEARCH_STEP_IDS = 100_000
+
+/** SQL conditions on items `i` for a search's type, size and date filters, and a size floor. */
+function searchFilters(req: SearchRequest, floor: number, params: Record<string, any>): string {
+  const where: string[] = []
+  const add = (cond: string, key: string, value: unknown) => {
+    if (value === undefined || value === null) return
+    where.push(`AND ${cond}`)
+    params[key] = value
+  }
+  const minBytes = Math.max(req.minBytes ?? 0, floor)
+  add('i.type = :type', ':type', req.type)
+  add('i.sizeBytes >= :minBytes', ':minBytes', minBytes > 0 ? minBytes : undefined)
+  add('i.sizeBytes <= :maxBytes', ':maxBytes', req.maxBytes)
+  add('i.lastWriteMs >= :modifiedAfter', ':modifiedAfter', req.modifiedAfterMs)
+  add('i.lastWriteMs < :modifiedBefore', ':modifiedBefore', req.modifiedBeforeMs)
+  return where.join(' ')
+}
+
+/** Raw rows (carrying `name`) of a statement run with `params`. */
+function allRows(db: any, sql: string, params: Record<string, any>): Record<string, any>[] {
+  const stmt = statement(db, sql)
+  const rows: Record<string, any>[] = []
+  stmt.bind(params)
+  while (stmt.step()) rows.push(stmt.getAsObject())
+  release(stmt)
   return rows
 }
 
-/** Look up a single item by path (case-sensitive). Returns null if not found. */
-export function getItemByPath(db: any, itemPath: string): ItemRecord | null {
-  const stmt = db.prepare('SELECT * FROM items WHERE path = :path LIMIT 1')
-  stmt.bind({ ':path': itemPath })
-  if (stmt.step()) {
-    return stmt.getAsObject() as ItemRecord
+/**
+ * The rows among the `headRows` largest whose name is LIKE `like` and that
+ * pass the filters of `req`, largest first, as raw rows carrying `name`.
+ * Read off idx_items_size, so it answers at once however many rows match.
+ */
+export function searchLargest(db: any, like: string, req: SearchRequest, headRows: number, limit: number) {
+  flushWrites(db)
+  const params: Record<string, any> = { ':like': like, ':head': headRows, ':limit': limit }
+  return allRows(db, `
+    SELECT n.name, i.* FROM (SELECT nodeId FROM items ORDER BY sizeBytes DESC LIMIT :head) h
+    CROSS JOIN nodes n ON n.id = h.nodeId CROSS JOIN items i ON i.nodeId = h.nodeId
+    WHERE n.name LIKE :like ${searchFilters(req, 0, params)} ORDER BY i.sizeBytes DESC LIMIT :limit`, params)
+}
+
+/**
+ * Distinct trigrams of the literal runs of `like`, lowercased as the
+ * tokenizer stores them. Runs with non-ASCII text are left out: the
+ * tokenizer may fold their case differently.
+ */
+function likeTrigrams(like: string): string[] {
+  const found = new Set<string>()
+  for (const run of like.split(/[%_]/)) {
+    if (!/^[\x20-\x7e]*$/.test(run)) continue
+    const r = run.toLowerCase()
+    for (let i = 0; i + 3 <= r.length; i++) found.add(r.slice(i, i + 3))
   }
-  return null
+  return [...found]
+}
+
+/** `text` as one FTS5 phrase. */
+function ftsPhrase(text: string): string {
+  return `"${text.replace(/"/g, '""')}"`
+}
+
+/**
+ * An FTS5 query for the names LIKE `like`, from the two rarest trigrams of
+ * the pattern, each counted first up to `cap` names: matching every
+ * trigram would walk the long lists of common ones (`fil`, `.dl`) in full.
+ * `names` is the fewest names any of them is in; 0 when nothing can match.
+ * Null without an index, or when no trigram narrows it below `cap` names.
+ */
+function trigramMatch(db: any, like: string, cap: number): { match: string; names: number } | null {
+  const trigrams = nameIndexes.has(db) ? likeTrigrams(like) : []
+  if (trigrams.length === 0) return null
+  const probe = statement(db, 'SELECT COUNT(*) AS n FROM (SELECT rowid FROM node_names WHERE node_names MATCH :term LIMIT :cap)')
+  const counts = trigrams.map((t) => {
+    probe.bind({ ':term': ftsPhrase(t), ':cap': cap })
+    const n = probe.step() ? Number(probe.getAsObject().n) : cap
+    probe.reset()
+    return { t, n }
+  })
+  release(probe)
+  const rarest = counts.filter((c) => c.n < cap).sort((a, b) => a.n - b.n).slice(0, 2)
+  if (rarest.length === 0) return null
+  return { match: rarest.map((c) => ftsPhrase(c.t)).join(' AND '), names: rarest[0].n }
+}
+
+/**
+ * Every row whose name is LIKE `like`, at least `floor` bytes and passing
+ * the filters of `req`, found through the trigram index. Null when the
+ * index cannot narrow the search below `cap` names, which leaves it to
+ * searchNames().
+ */
+export function searchIndexed(db: any, like: string, req: SearchRequest, cap: number, floor: number) {
+  flushWrites(db)
+  const found = trigramMatch(db, like, cap)
+  if (!found) return null
+  if (found.names === 0) return []
+  const params: Record<string, any> = { ':match': found.match, ':like': like }
+  return allRows(db, `
+    SELECT n.name, i.* FROM node_names f CROSS JOIN nodes n ON n.id = f.rowid CROSS JOIN items i ON i.nodeId = f.rowid
+    WHERE node_names MATCH :match AND n.name LIKE :like ${searchFilters(req, floor, params)}`, params)
+}
+
+/**
+ * One step of a scan through every name for those LIKE `like`, in node id
+ * order from just after node `after`: up to `limit` raw rows (carrying
+ * `name`) of at least `floor` bytes that pass the filters of `req`, and the
+ * id to continue after — null once done.
+ */
+export function searchNames(
+  db: any,
+  like: string,
+  req: SearchRequest,
+  after: number,
+  limit: number,
+  floor: number
+): { rows: Record<string, any>[]; next: number | null } {
+  flushWrites(db)
+  const last = statement(db, 'SELECT MAX(id) AS id FROM nodes')
+  const maxId = last.step() ? Number(last.getAsObject().id ?? 0) : 0
+  release(last)
+  const until = after + SEARCH_STEP_IDS
+  const params: Record<string, any> = { ':like': like, ':from': after, ':until': until, ':limit': limit }
+  const rows = allRows(db, `
+    SELECT n.name, i.* FROM nodes n CROSS JOIN items i ON i.nodeId = n.id
+    WHERE n.id > :from AND n.id <= :until AND n.name LIKE :like ${searchFilters(req, floor, params)}
+    ORDER BY n.id LIMIT :limit`, params)
+  if (rows.length === limit) return { rows, next: rows[rows.length - 1].nodeId }
+  return { rows, next: until < maxId ? until : null }
+}
+
+/* ============================================================
+   Filter queries — a parsed filter as one statement on one index
+   ============================================================ */
+
+/** Most rows a subtree, name or type lookup may hand a filter to sort; past that the size order leads. */
+const FILTER_LEAD_ROWS = 50_000
+/** Rows of idx_items_size one filterPage() call goes through at most, so no call blocks for long. */
+const FILTER_STEP_ROWS = 20_000
+
+/** A filter compiled for one shard by compileFilter(). */
+export interface CompiledFilter {
+  /**
+   * The index the statement starts from: idx_items_size, already in
+   * result order, or a subtree, the trigram index of names or
+   * idx_items_type, each bounded by FILTER_LEAD_ROWS and sorted.
+   */
+  lead: 'size' | 'subtree' | 'names' | 'type'
+  /** `WITH` clause (or ''), FROM clause and WHERE conditions, joined by filterSql(). */
+  ctes: string
+  from: string
+  where: string[]
+  params: Record<string, any>
+  /** The size terms alone, which bound the walk of idx_items_size. */
+  range: { where: string[]; params: Record<string, any> }
+}
+
+/** A filter name term as a LIKE pattern; `escape` makes `%`, `_` and `\` literal under ESCAPE '\'. */
+function nameLike(text: string, escape: boolean): string {
+  const lit = escape ? text.replace(/[\\%_]/g, '\\$&') : text
+  const p = lit.replace(/\*/g, '%').replace(/\?/g, '_')
+  return /[*?]/.test(text) ? p : `%${p}%`
+}
+
+/**
+ * The statement of a compiled filter. With `cursor` it continues after
+ * (`:afterSize`, `:afterId`); with `bounded` it stops at (`:endSize`,
+ * `:endId`).
+ */
+function filterSql(c: CompiledFilter, cursor: boolean, bounded: boolean): string {
+  const where = [...c.where]
+  if (cursor) where.push('i.sizeBytes <= :afterSize', '(i.sizeBytes < :afterSize OR i.nodeId > :afterId)')
+  if (bounded) where.push('i.sizeBytes >= :endSize', '(i.sizeBytes > :endSize OR i.nodeId <= :endId)')
+  return `${c.ctes} SELECT n.name, i.* FROM ${c.from}
+    ${where.length ? `WHERE ${where.join(' AND ')}` : ''} ORDER BY i.sizeBytes DESC, i.nodeId LIMIT :limit`
+}
+
+/**
+ * The lines of a statement's query plan that read a whole table or index.
+ * A walk down idx_items_size is not one: it is the result order, and the
+ * LIMIT or the step bound ends it.
+ */
+function fullScans(db: any, sql: string, params: Record<string, any>): string[] {
+  const stmt = db.prepare(`EXPLAIN QUERY PLAN ${sql}`)
+  const found: string[] = []
+  stmt.bind(params)
+  while (stmt.step()) {
+    const detail = String(stmt.getAsObject().detail)
+    const m = /^SCAN (\w+)(.*)$/.exec(detail)
+    if (m && ['i', 'n', 'c', 'items', 'nodes'].includes(m[1]) && !m[2].startsWith(' USING INDEX idx_items_size')) {
+      found.push(detail)
+    }
+  }
+  stmt.free()
+  return found
+}
+
+/** Rows of a capped count query, at most `cap`. */
+function countUpTo(db: any, sql: string, params: Record<string, any>, cap: number): number {
+  const stmt = statement(db, `SELECT COUNT(*) AS n FROM (${sql} LIMIT :cap)`)
+  stmt.bind({ ...params, ':cap': cap })
+  const n = stmt.step() ? Number(stmt.getAsObject().n) : cap
+  release(stmt)
+  return n
+}
+
+/**
+ * Compile a parsed filter (see filter.ts) for this shard into one
+ * statement, largest rows first. It starts from one index: a folder's
+ * subtree (`under:`), the trigram index of names or idx_items_type when
+ * that yields at most FILTER_LEAD_ROWS rows to sort, otherwise
+ * idx_items_size, which is the result order already. The other terms
+ * become conditions on the rows it reaches. The plan is checked with
+ * EXPLAIN QUERY PLAN, and a filter that would read a whole table is
+ * refused. Null when nothing can match.
+ */
+export function compileFilter(db: any, terms: FilterTerm[]): CompiledFilter | null {
+  flushWrites(db)
+  const params: Record<string, any> = {}
+  const param = (value: unknown) => {
+    const key = `:f${Object.keys(params).length}`
+    params[key] = value
+    return key
+  }
+  const ctes: string[] = []
+  const subtrees = new Map<FilterTerm, { cte: string; id: number } | null>()
+  const condition = (t: FilterTerm): string => {
+    switch (t.kind) {
+      case 'type': return `i.type = ${param(t.type)}`
+      case 'size': return `i.sizeBytes ${t.op} ${param(t.bytes)}`
+      case 'modified': return `i.lastWriteMs ${t.op} ${param(t.ms)}`
+      case 'name': return `n.name LIKE ${param(nameLike(t.text, true))} ESCAPE '\\'`
+      case 'all': return `(${t.terms.map(condition).join(' AND ')})`
+      case 'any': return `(${t.terms.map(condition).join(' OR ')})`
+      case 'not': return `NOT ${condition(t.term)}`
+      case 'under': {
+        const id = lookupNode(db, t.path)
+        if (id === null) {
+          subtrees.set(t, null)
+          return '0'
+        }
+        const cte = `u${ctes.length}`
+        ctes.push(`${cte}(id) AS (SELECT id FROM nodes WHERE parentId = ${param(id)}
+          UNION ALL SELECT c.id FROM nodes c JOIN ${cte} ON c.parentId = ${cte}.id)`)
+        subtrees.set(t, { cte, id })
+        return `i.nodeId IN ${cte}`
+      }
+    }
+  }
+  const where = terms.map(condition)
+
+  // The fewest rows any term that every row must pass leads to
+  let lead: { index: number; lead: CompiledFilter['lead']; rows: number; match?: string } | null = null
+  for (const [index, t] of terms.entries()) {
+    let rows = Infinity
+    let match: string | undefined
+    if (t.kind === 'under') {
+      const sub = subtrees.get(t)
+      if (!sub) return null
+      const counts = statement(db, 'SELECT fileCount + folderCount AS n FROM items WHERE nodeId = :id')
+      counts.bind({ ':id': sub.id })
+      if (counts.step()) rows = Number(counts.getAsObject().n)
+      release(counts)
+    } else if (t.kind === 'type') {
+      rows = countUpTo(db, 'SELECT 1 FROM items WHERE type = :type', { ':type': t.type }, FILTER_LEAD_ROWS + 1)
+    } else if (t.kind === 'name' || (t.kind === 'any' && t.terms.every((a) => a.kind === 'name'))) {
+      const names = t.kind === 'name' ? [t] : (t.terms as { text: string }[])
+      const found = names.map((a) => trigramMatch(db, nameLike(a.text, false), FILTER_LEAD_ROWS))
+      if (found.some((f) => !f)) continue
+      const possible = found.filter((f) => f!.names > 0)
+      if (possible.length === 0) return null
+      rows = possible.reduce((sum, f) => sum + f!.names, 0)
+      match = possible.map((f) => `(${f!.match})`).join(' OR ')
+    }
+    if (rows <= FILTER_LEAD_ROWS && (!lead || rows < lead.rows)) {
+      const kind = t.kind === 'under' ? 'subtree' : t.kind === 'type' ? 'type' : 'names'
+      lead = { index, lead: kind, rows, match }
+    }
+  }
+
+  let from = 'items i INDEXED BY idx_items_size CROSS JOIN nodes n ON n.id = i.nodeId'
+  if (lead?.lead === 'subtree') {
+    // Rows come from the subtree walk itself; no membership test needed
+    const { cte } = subtrees.get(terms[lead.index])!
+    from = `${cte} CROSS JOIN nodes n ON n.id = ${cte}.id CROSS JOIN items i ON i.nodeId = ${cte}.id`
+    where.splice(lead.index, 1)
+  } else if (lead?.lead === 'type') {
+    from = 'items i INDEXED BY idx_items_type CROSS JOIN nodes n ON n.id = i.nodeId'
+  } else if (lead?.lead === 'names') {
+    // The trigrams narrow the names down; the LIKE condition stays for the exact test
+    from = 'node_names f CROSS JOIN nodes n ON n.id = f.rowid CROSS JOIN items i ON i.nodeId = f.rowid'
+    where.unshift(`node_names MATCH ${param(lead.match)}`)
+  }
+  const compiled: CompiledFilter = {
+    lead: lead?.lead ?? 'size',
+    ctes: ctes.length ? `WITH RECURSIVE ${ctes.join(', ')}` : '',
+    from,
+    where,
+    params,
+    range: { where: [], params: {} }
+  }
+  for (const t of terms) {
+    if (t.kind !== 'size') continue
+    const key = `:r${compiled.range.where.length}`
+    compiled.range.where.push(`sizeBytes ${t.op} ${key}`)
+    compiled.range.params[key] = t.bytes
+  }
+  for (const [cursor, bounded] of [[false, false], [true, false], [true, true]]) {
+    const scans = fullScans(db, filterSql(compiled, cursor, bounded), { ...params, ':limit': 0 })
+    if (scans.length) throw new Error(`This filter would read every row (${scans.join('; ')})`)
+  }
+  return compiled
+}
+
+/**
+ * The next rows of a compiled filter, largest first: up to `limit`, from
+ * at most FILTER_STEP_ROWS rows of the size order, so a rare match costs
+ * several calls rather than one long one. Pass the previous call's
+ * `nextCursor` to continue right after it; none is returned once done.
+ */
+export function filterPage(db: any, c: CompiledFilter, limit: number, cursor?: string) {
+  flushWrites(db)
+  const params: Record<string, any> = { ...c.params, ':limit': limit }
+  const m = cursor && /^s:(-?\d+):(\d+)$/.exec(cursor)
+  if (m) {
+    params[':afterSize'] = Number(m[1])
+    params[':afterId'] = Number(m[2])
+  }
+  // The last row of this step's stretch of the size order; none when it runs to the end
+  let end: Record<string, any> | null = null
+  if (c.lead === 'size') {
+    const where = [...c.range.where]
+    const stepParams: Record<string, any> = { ...c.range.params, ':skip': FILTER_STEP_ROWS - 1 }
+    if (m) {
+      where.push('sizeBytes <= :afterSize', '(sizeBytes < :afterSize OR nodeId > :afterId)')
+      stepParams[':afterSize'] = params[':afterSize']
+      stepParams[':afterId'] = params[':afterId']
+    }
+    const stmt = statement(db, `SELECT sizeBytes, nodeId FROM items INDEXED BY idx_items_size
+      ${where.length ? `WHERE ${where.join(' AND ')}` : ''} ORDER BY sizeBytes DESC, nodeId LIMIT 1 OFFSET :skip`)
+    stmt.bind(stepParams)
+    end = stmt.step() ? { ...stmt.getAsObject() } : null
+    release(stmt)
+    if (end) {
+      params[':endSize'] = end.sizeBytes
+      params[':endId'] = end.nodeId
+    }
+  }
+  const stmt = db.prepare(filterSql(c, !!m, !!end))
+  const found: Record<string, any>[] = []
+  stmt.bind(params)
+  while (stmt.step()) found.push({ ...stmt.getAsObject() })
+  stmt.free()
+  const last = found.length === limit ? found[found.length - 1] : end
+  return { items: withPaths(db, found), nextCursor: last ? childCursor('size_desc', last) : undefined }
+}
+
+/* ============================================================
+   Tree export — one root's rows, a folder at a time
+   ============================================================ */
+
+const TREE_COLUMNS = 'i.nodeId, n.name, i.type, i.sizeBytes, i.fileCount, i.folderCount, i.lastWriteMs, i.scannedMs, i.depth'
+
+/** The row of `rootPath` with its node id, to start a tree export from; null when it has none. */
+export function treeRoot(db: any, rootPath: string): Record<string, any> | null {
+  flushWrites(db)
+  const id = lookupNode(db, rootPath)
+  if (id === null) return null
+  const stmt = statement(db, `SELECT ${TREE_COLUMNS} FROM items i JOIN nodes n ON n.id = i.nodeId WHERE i.nodeId = :id`)
+  stmt.bind({ ':id': id })
+  const row = stmt.step() ? { ...stmt.getAsObject() } : null
+  release(stmt)
+  return row
+}
+
+/** The rows directly below node `parentId`, with their node ids; one seek of idx_items_children. */
+export function treeChildren(db: any, parentId: number): Record<string, any>[] {
+  const stmt = statement(db, `SELECT ${TREE_COLUMNS} FROM items i JOIN nodes n ON n.id = i.nodeId WHERE i.parentId = :id`)
+  stmt.bind({ ':id': parentId })
+  const rows: Record<string, any>[] = []
+  while (stmt.step()) rows.push({ ...stmt.getAsObject() })
+  release(stmt)
+  return rows
 }
@@ -0,0 +1,222 @@
+import path from 'node:path'
+import { CompareOp, FilterPage, FilterTerm, ItemRecord, ItemType } from '../shared/types'
+import { CompiledFilter, compileFilter, filterPage } from './db'
+import { ShardSet } from './shards'
+
+/* ============================================================
+   Filter language — `type:file size>1G ext:iso,vmdk` → terms
+   ============================================================ */
+
+/**
+ * A filter is a list of terms, all of which must hold:
+ *
+ *   type:file  type:folder          size>1G  size<=500M  size=0
+ *   modified<2023-01-01             modified>=2024-06-01T12:00
+ *   ext:iso,vmdk                    name:backup  name:*.bak,*.old
+ *   under:/data  under:"C:\My Files"
+ *   backup-2023  *.vmdk             (a bare word is a name term)
+ *
+ * A leading `-` negates a term; a comma list matches any of its values.
+ * Sizes take K, M, G or T (powers of 1000, as the UI shows them); dates
+ * without a time mean local midnight, so `modified=2023-01-01` is that
+ * whole day. Double quotes keep spaces in a value.
+ */
+export function parseFilter(text: string): FilterTerm[] {
+  const terms: FilterTerm[] = []
+  for (const token of tokenize(text)) {
+    const negate = token.length > 1 && token.startsWith('-')
+    const parsed = parseTerm(negate ? token.slice(1) : token)
+    if (!negate) terms.push(...parsed)
+    else terms.push({ kind: 'not', term: parsed.length === 1 ? parsed[0] : { kind: 'all', terms: parsed } })
+  }
+  return terms
+}
+
+/** Whitespace-separated tokens; double quotes keep spaces and are dropped. */
+function tokenize(text: string): string[] {
+  const tokens: string[] = []
+  let current = ''
+  let quoted = false
+  let started = false
+  for (const ch of text) {
+    if (ch === '"') {
+      quoted = !quoted
+      started = true
+    } else if (!quoted && /\s/.test(ch)) {
+      if (started) tokens.push(current)
+      current = ''
+      started = false
+    } else {
+      current += ch
+      started = true
+    }
+  }
+  if (quoted) throw new Error('Unclosed quote in filter')
+  if (started) tokens.push(current)
+  return tokens
+}
+
+/** One term, or any of several. */
+function any(terms: FilterTerm[]): FilterTerm {
+  return terms.length === 1 ? terms[0] : { kind: 'any', terms }
+}
+
+/** Comma-separated values, none empty. */
+function values(key: string, value: string): string[] {
+  const list = value.split(',')
+  if (list.some((v) => !v)) throw new Error(`Empty value in '${key}:${value}'`)
+  return list
+}
+
+const TYPES: Record<string, ItemType> = { file: 'File', files: 'File', folder: 'Folder', folders: 'Folder', dir: 'Folder' }
+const SIZE_UNITS: Record<string, number> = { '': 1, k: 1e3, m: 1e6, g: 1e9, t: 1e12 }
+const DAY_MS = 24 * 60 * 60 * 1000
+
+function parseTerm(token: string): FilterTerm[] {
+  const compare = /^(size|modified)(<=|>=|<|>|=)(.+)$/i.exec(token)
+  if (compare) {
+    const op = compare[2] as CompareOp
+    if (compare[1].toLowerCase() === 'size') return [{ kind: 'size', op, bytes: parseSize(compare[3]) }]
+    const { ms, day } = parseDate(compare[3])
+    // A date without a time stands for the whole day
+    if (!day) return [{ kind: 'modified', op, ms }]
+    if (op === '=') return [{ kind: 'modified', op: '>=', ms }, { kind: 'modified', op: '<', ms: ms + DAY_MS }]
+    if (op === '<=') return [{ kind: 'modified', op: '<', ms: ms + DAY_MS }]
+    if (op === '>') return [{ kind: 'modified', op: '>=', ms: ms + DAY_MS }]
+    return [{ kind: 'modified', op, ms }]
+  }
+  const unknown = /^([a-z]+)(<|>)/i.exec(token)
+  if (unknown) throw new Error(`Unknown filter '${unknown[1]}${unknown[2]}': compare size or modified`)
+  const colon = token.indexOf(':')
+  if (colon < 0) return [{ kind: 'name', text: token }]
+  const key = token.slice(0, colon).toLowerCase()
+  const value = token.slice(colon + 1)
+  switch (key) {
+    case 'type':
+      return [any(values(key, value).map((v) => {
+        const type = TYPES[v.toLowerCase()]
+        if (!type) throw new Error(`Unknown type '${v}': use file or folder`)
+        return { kind: 'type', type }
+      }))]
+    case 'ext':
+      return [any(values(key, value).map((v) => ({ kind: 'name', text: `*.${v.replace(/^\./, '')}` })))]
+    case 'name':
+      return [any(values(key, value).map((v) => ({ kind: 'name', text: v })))]
+    case 'under':
+      if (!value) throw new Error("Empty folder in 'under:'")
+      return [{ kind: 'under', path: path.resolve(value) }]
+    default:
+      throw new Error(`Unknown filter '${key}:': use type, name, ext, size, modified or under`)
+  }
+}
+
+function parseSize(text: string): number {
+  const m = /^(\d+(?:\.\d+)?)\s*([kmgt]?)b?$/i.exec(text)
+  if (!m) throw new Error(`Not a size: '${text}'`)
+  return Math.round(Number(m[1]) * SIZE_UNITS[m[2].toLowerCase()])
+}
+
+/** Epoch ms of a date, and whether it was a bare day (local midnight). */
+function parseDate(text: string): { ms: number; day: boolean } {
+  const d = /^(\d{4})-(\d{2})-(\d{2})$/.exec(text)
+  if (d) return { ms: new Date(Number(d[1]), Number(d[2]) - 1, Number(d[3])).getTime(), day: true }
+  const ms = Date.parse(text)
+  if (Number.isNaN(ms)) throw new Error(`Not a date: '${text}'`)
+  return { ms, day: false }
+}
+
+/* ============================================================
+   Filter runs — pages merged across shards, largest first
+   ============================================================ */
+
+/** Rows per page sent, and per query of one shard. */
+const PAGE_ROWS = 200
+const DEFAULT_LIMIT = 1000
+
+/** Active filter runs that can be cancelled. */
+export const activeFilters = new Map<string, { cancel: () => void }>()
+
+function bySizeDesc(a: ItemRecord, b: ItemRecord) {
+  return b.sizeBytes - a.sizeBytes
+}
+
+/**
+ * Send the rows `terms` select, largest first, as pages through `onPage`
+ * until `limit` rows went out. Shards are read one after another, each
+ * opened under ShardSet's usual limits and pinned only while it is read,
+ * a page at a time until it can add nothing to the list. Rows of the
+ * shards before the last are held; the last one's pages go out merged
+ * with them as they arrive, so a single shard streams as before.
+ * A filter with `under:` reads the shard holding that folder and those
+ * of roots below it. A row counts only in the shard that holds its path,
+ * so a subtree written to two shards is listed once.
+ */
+export async function runFilter(
+  shards: ShardSet,
+  filterId: string,
+  terms: FilterTerm[],
+  limit: number | undefined,
+  onPage: (page: FilterPage) => void
+) {
+  const max = limit ?? DEFAULT_LIMIT
+  let cancelled = false
+  activeFilters.set(filterId, { cancel: () => { cancelled = true } })
+  const send = (state: FilterPage['state'], items: ItemRecord[] = [], message?: string) => {
+    onPage({ filterId, state, message, items })
+  }
+
+  try {
+    const under = terms.find((t): t is Extract<FilterTerm, { kind: 'under' }> => t.kind === 'under')
+    const targets = under ? shards.holding(under.path) : shards.list()
+    // Largest rows not sent yet, across the shards read so far
+    let held: ItemRecord[] = []
+    let sent = 0
+    const flush = (rows: ItemRecord[]) => {
+      for (let i = 0; i < rows.length && sent < max; i += PAGE_ROWS) {
+        const page = rows.slice(i, Math.min(i + PAGE_ROWS, i + max - sent))
+        sent += page.length
+        send('running', page)
+      }
+    }
+
+    for (const [k, summary] of targets.entries()) {
+      if (cancelled || sent >= max) break
+      const last = k === targets.length - 1
+      // Retired by a scan that finished meanwhile
+      if (!shards.list().includes(summary)) continue
+      const shard = await shards.open(summary)
+      shards.pin(shard.dbPath, 1)
+      try {
+        const filter = compileFilter(shard.db, terms)
+        let cursor: string | undefined
+        let read = 0
+        for (let more = !!filter; more && !cancelled && sent < max;) {
+          const next = filterPage(shard.db, filter!, PAGE_ROWS, cursor)
+          cursor = next.nextCursor
+          read += next.items.length
+          more = !!cursor && read < max
+          const rows = next.items.filter((r) => shards.shardOf(r.path) === summary)
+          held = held.concat(rows).sort(bySizeDesc).slice(0, max - sent)
+          if (last) {
+            // Nothing still to come from this shard is larger than its last row
+            const floor = more && next.items.length ? next.items[next.items.length - 1].sizeBytes : -Infinity
+            const ready = held.findIndex((r) => r.sizeBytes < floor)
+            flush(held.splice(0, ready < 0 ? held.length : ready))
+          } else if (held.length >= max && next.items.length && next.items[next.items.length - 1].sizeBytes < held[held.length - 1].sizeBytes) {
+            // Past the smallest row the list keeps
+            more = false
+          }
+          await new Promise((resolve) => setImmediate(resolve))
+        }
+      } finally {
+        shards.pin(shard.dbPath, -1)
+      }
+    }
+    if (!cancelled) flush(held)
+    send(cancelled ? 'cancelled' : 'completed')
+  } catch (err: any) {
+    send('error', [], err?.message ?? String(err))
+  } finally {
+    activeFilters.delete(filterId)
+  }
+}
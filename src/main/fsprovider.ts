@@ -0,0 +1,159 @@
+import fs from 'node:fs'
+import path from 'node:path'
+import { syntheticProvider, parseSyntheticShape, SYNTHETIC_ROOT } from './memfs'
+
+/* ============================================================
+   Filesystem providers — where scans and listings read from
+   ============================================================ */
+
+/** Directory entry; fs.Dirent satisfies it. */
+export interface FsEntry {
+  name: string
+  isFile(): boolean
+  isDirectory(): boolean
+}
+
+/** File metadata; fs.Stats satisfies it. */
+export interface FsStat {
+  size: number
+  mtimeMs: number
+  isFile(): boolean
+  isDirectory(): boolean
+}
+
+/** Exact directory identity; fs.BigIntStats satisfies it. */
+export interface FsIdStat {
+  dev: bigint
+  ino: bigint
+  mtimeMs: bigint
+}
+
+/** Streamed listing; fs.Dir satisfies it. */
+export interface FsDir {
+  readSync(): FsEntry | null
+  closeSync(): void
+}
+
+/**
+ * Filesystem calls the scanner, shallow scan and list-dir depend on. The
+ * sync calls serve the sequential walker and listings; the promise-based
+ * ones feed the pipelined walker and reject as soon as `signal` aborts,
+ * even while the call is still pending.
+ */
+export interface FsProvider {
+  readdirSync(dir: string): FsEntry[]
+  /** Streamed listing, so huge directories can be abandoned part-way. */
+  opendirSync(dir: string): FsDir
+  statSync(p: string): FsStat
+  /** Stat with exact 64-bit dev/ino, used for directories. */
+  statBigSync(p: string): FsIdStat
+  readdir(dir: string, signal?: AbortSignal): Promise<FsEntry[]>
+  stat(p: string, signal?: AbortSignal): Promise<FsStat>
+  statBig(p: string, signal?: AbortSignal): Promise<FsIdStat>
+}
+
+/**
+ * Settle with `op` or reject on abort, whichever comes first. Node's
+ * readdir/stat take no signal, so an aborted call finishes unobserved.
+ */
+export function abortable<T>(op: Promise<T>, signal?: AbortSignal): Promise<T> {
+  if (!signal) return op
+  if (signal.aborted) return Promise.reject(signal.reason)
+  return new Promise<T>((resolve, reject) => {
+    const onAbort = () => reject(signal.reason)
+    signal.addEventListener('abort', onAbort, { once: true })
+    op.then(resolve, reject).finally(() => signal.removeEventListener('abort', onAbort))
+  })
+}
+
+/** The real disk. */
+export const diskProvider: FsProvider = {
+  readdirSync: (dir) => fs.readdirSync(dir, { withFileTypes: true }),
+  opendirSync: (dir) => fs.opendirSync(dir),
+  statSync: (p) => fs.statSync(p),
+  statBigSync: (p) => fs.statSync(p, { bigint: true }),
+  readdir: (dir, signal) => abortable(fs.promises.readdir(dir, { withFileTypes: true }), signal),
+  stat: (p, signal) => abortable(fs.promises.stat(p), signal),
+  statBig: (p, signal) => abortable(fs.promises.stat(p, { bigint: true }), signal)
+}
+
+/** Serve paths at or below `root` from `inner`, everything else from `base`. */
+export function mountProvider(base: FsProvider, root: string, inner: FsProvider): FsProvider {
+  const prefix = root.endsWith(path.sep) ? root : root + path.sep
+  const pick = (p: string) => (p === root || p.startsWith(prefix) ? inner : base)
+  return {
+    readdirSync: (dir) => pick(dir).readdirSync(dir),
+    opendirSync: (dir) => pick(dir).opendirSync(dir),
+    statSync: (p) => pick(p).statSync(p),
+    statBigSync: (p) => pick(p).statBigSync(p),
+    readdir: (dir, signal) => pick(dir).readdir(dir, signal),
+    stat: (p, signal) => pick(p).stat(p, signal),
+    statBig: (p, signal) => pick(p).statBig(p, signal)
+  }
+}
+
+/* ============================================================
+   Latency shim — emulates a network mount on a local disk
+   ============================================================ */
+
+const sleepCell = new Int32Array(new SharedArrayBuffer(4))
+
+/** Block the calling thread, like a synchronous call to a remote server. */
+function sleepSync(ms: number) {
+  Atomics.wait(sleepCell, 0, 0, ms)
+}
+
+/**
+ * Wrap a provider so every call pays a round trip of `minMs`–`maxMs`.
+ * Async calls wait on a timer (so many can overlap, as on a real share);
+ * sync calls block for the full delay.
+ */
+export function withLatency(base: FsProvider, minMs: number, maxMs = minMs): FsProvider {
+  const delay = () => minMs + Math.random() * (maxMs - minMs)
+  const later = <T>(op: () => Promise<T>, signal?: AbortSignal) =>
+    abortable(new Promise<T>((resolve, reject) => {
+      setTimeout(() => op().then(resolve, reject), delay())
+    }), signal)
+  const blocking = <A, T>(op: (a: A) => T) => (a: A) => {
+    sleepSync(delay())
+    return op(a)
+  }
+  return {
+    readdirSync: blocking((dir: string) => base.readdirSync(dir)),
+    opendirSync: blocking((dir: string) => base.opendirSync(dir)),
+    statSync: blocking((p: string) => base.statSync(p)),
+    statBigSync: blocking((p: string) => base.statBigSync(p)),
+    readdir: (dir, signal) => later(() => base.readdir(dir), signal),
+    stat: (p, signal) => later(() => base.stat(p), signal),
+    statBig: (p, signal) => later(() => base.statBig(p), signal)
+  }
+}
+
+/**
+ * Returns `base`, wrapped in the latency shim when `LFB_FS_LATENCY_MS` is
+ * set to a fixed delay ("5") or a range ("1-20").
+ */
+function withLatencyFromEnv(base: FsProvider): FsProvider {
+  const spec = process.env.LFB_FS_LATENCY_MS
+  if (!spec) return base
+  const [lo, hi] = spec.split('-').map(Number)
+  if (!Number.isFinite(lo) || lo <= 0) return base
+  return withLatency(base, lo, Number.isFinite(hi) && hi >= lo ? hi : lo)
+}
+
+let active: FsProvider | null = null
+
+/**
+ * The provider the app reads from: the disk, with a synthetic tree mounted
+ * at SYNTHETIC_ROOT when `LFB_SYNTHETIC_TREE` is set ("fanout,files,depth"),
+ * all behind the latency shim when `LFB_FS_LATENCY_MS` is set.
+ */
+export function activeFsProvider(): FsProvider {
+  if (!active) {
+    let p = diskProvider
+    const shape = parseSyntheticShape(process.env.LFB_SYNTHETIC_TREE)
+    if (shape) p = mountProvider(p, SYNTHETIC_ROOT, syntheticProvider(SYNTHETIC_ROOT, shape))
+    active = withLatencyFromEnv(p)
+  }
+  return active
+}
@@ -1,45 +1,72 @@
 import { BrowserWindow, dialog, ipcMain, shell } from 'electron'
 import fs from 'node:fs'
 import path from 'node:path'
-import { ChildRequest, ScanRequest, TopRequest, ListDirEntry, ListDirResponse, ScanStatus, DriveInfo } from '../shared/types'
-import { getChildren, getRoots, getTop, openDatabase, resetDatabase } from './db'
+import { ChildRequest, FilterPage, FilterRequest, GrowthRequest, ScanFileTopRequest, ScanRequest, SearchRequest, SearchStatus, SnapshotInfo, TopRequest, ListDirEntry, ListDirResponse, ScanStatus, DriveInfo } from '../shared/types'
+import { getChildren, getGrowth, getSizeAt, listSnapshots } from './db'
 import { runScan, runScanAsync, activeScans, ScanProgress } from './scanner'
+import { activeFsProvider } from './fsprovider'
+import { findArchiveNode, isArchiveName, readArchiveIndex, splitArchivePath } from './archive'
+import { onPersisted } from './persist'
+import { ShardSet } from './shards'
+import { activeSearches, runSearch } from './search'
+import { activeFilters, parseFilter, runFilter } from './filter'
+import { exportScanFile, openScanFile } from './columnar'
 
-let dbHandle: any
-let dbPath: string
-let dbReady: Promise<void> | null = null
+let shards: ShardSet
+let shardsReady: Promise<void> | null = null
 
-function ensureDb() {
-  if (!dbReady) {
-    dbReady = openDatabase().then((res) => {
-      dbHandle = res.db
-      dbPath = res.dbPath
+/**
+ * Read the shard catalog, which answers the first queries on its own;
+ * the shards themselves then open in the background.
+ */
+function ensureShards() {
+  if (!shardsReady) {
+    shardsReady = ShardSet.load().then((set) => {
+      shards = set
+      shards.warm()
     })
   }
-  return dbReady
+  return shardsReady
+}
+
+/** Put what the open shards hold into the catalog — for quitting. */
+export function saveCatalog() {
+  shards?.saveOpen()
 }
 
 export function setupIpc(mainWindow: BrowserWindow) {
-  ensureDb()
+  ensureShards()
+
+  // Tell the UI when scan data last became durable on disk, and keep the
+  // catalog's summary of that shard current for the next launch
+  onPersisted((savedPath, savedAt) => {
+    shards?.persisted(savedPath)
+    if (!mainWindow.isDestroyed()) mainWindow.webContents.send('db-saved', new Date(savedAt).toISOString())
+  })
 
   /* ---- DB queries ---- */
 
   ipcMain.handle('children', async (_event, req: ChildRequest) => {
-    await ensureDb()
+    // A cursor already says where the page starts
+    if (req.cursor !== undefined && req.offset !== undefined) {
+      throw new Error('children: pass either cursor or offset, not both')
+    }
+    await ensureShards()
     const parent = req.parent ?? null
-    const doQuery = () => {
+    const doQuery = async () => {
+      // The root view comes from the catalog; a folder opens its shard
       if (parent === null) {
-        return getRoots(dbHandle, req.limit ?? 200, req.sort ?? 'size_desc')
+        return shards.roots(req.limit ?? 200, req.sort ?? 'size_desc')
       }
-      return getChildren(dbHandle, parent, req.limit ?? 200, req.offset ?? 0, req.sort ?? 'size_desc', req.includeFiles ?? true)
+      const shard = await shards.forPath(parent)
+      if (!shard) return { items: [], total: 0 }
+      return getChildren(shard.db, parent, req.limit ?? 200, req.offset ?? 0, req.sort ?? 'size_desc', req.includeFiles ?? true, req.cursor)
     }
     try {
-      return doQuery()
+      return await doQuery()
     } catch (err: any) {
       if (String(err?.message ?? err).includes('datatype mismatch')) {
-        const res = await resetDatabase(dbPath)
-        dbHandle = res.db
-        dbPath = res.dbPath
+        await shards.reset()
         return doQuery()
       }
       throw err
@@ -47,20 +74,133 @@ export function setupIpc(mainWindow: BrowserWindow) {
   })
 
   ipcMain.handle('top', async (_event, req: TopRequest) => {
-    await ensureDb()
+    await ensureShards()
     try {
-      return getTop(dbHandle, req.type, req.limit ?? 100)
+      return shards.top(req.type, req.limit ?? 100)
     } catch (err: any) {
       if (String(err?.message ?? err).includes('datatype mismatch')) {
-        const res = await resetDatabase(dbPath)
-        dbHandle = res.db
-        dbPath = res.dbPath
-        return getTop(dbHandle, req.type, req.limit ?? 100)
+        await shards.reset()
+        return shards.top(req.type, req.limit ?? 100)
       }
       throw err
     }
   })
 
+  /* ---- Scan history ---- */
+
+  // Snapshot ids are per shard; the path of the question picks the shard
+  ipcMain.handle('snapshots', async (_event, rootPath?: string) => {
+    await ensureShards()
+    if (rootPath !== undefined) {
+      const shard = await shards.forPath(rootPath)
+      return shard ? listSnapshots(shard.db, rootPath) : []
+    }
+    const all: SnapshotInfo[] = []
+    for await (const shard of shards.each()) all.push(...listSnapshots(shard.db))
+    return all.sort((a, b) => b.takenMs - a.takenMs)
+  })
+
+  ipcMain.handle('size-at', async (_event, folderPath: string, snapshotId: number) => {
+    await ensureShards()
+    const shard = await shards.forPath(folderPath)
+    return shard ? getSizeAt(shard.db, folderPath, snapshotId) : null
+  })
+
+  ipcMain.handle('growth', async (_event, req: GrowthRequest) => {
+    await ensureShards()
+    const shard = await shards.forPath(req.parent)
+    return shard ? getGrowth(shard.db, req.parent, req.snapshotId, req.limit ?? 200) : []
+  })
+
+  /* ---- Name search (non-blocking) ---- */
+
+  // Returns at once; the best matches so far follow as search-status events
+  ipcMain.handle('search', async (_event, req: SearchRequest) => {
+    await ensureShards()
+    const { randomUUID } = await import('node:crypto')
+    const searchId = randomUUID()
+    runSearch(shards, searchId, req, (status: SearchStatus) => {
+      if (!mainWindow.isDestroyed()) mainWindow.webContents.send('search-status', status)
+    })
+    return { searchId }
+  })
+
+  ipcMain.handle('cancel-search', async (_event, searchId: string) => {
+    const search = activeSearches.get(searchId)
+    if (search) {
+      search.cancel()
+      return { ok: true }
+    }
+    return { ok: false, message: 'Search not found or already completed' }
+  })
+
+  /* ---- Filter queries (non-blocking) ---- */
+
+  // A query that does not parse is refused here; its rows follow as filter-page events
+  ipcMain.handle('filter', async (_event, req: FilterRequest) => {
+    const terms = parseFilter(req.query)
+    await ensureShards()
+    const { randomUUID } = await import('node:crypto')
+    const filterId = randomUUID()
+    runFilter(shards, filterId, terms, req.limit, (page: FilterPage) => {
+      if (!mainWindow.isDestroyed()) mainWindow.webContents.send('filter-page', page)
+    })
+    return { filterId }
+  })
+
+  ipcMain.handle('cancel-filter', async (_event, filterId: string) => {
+    const filter = activeFilters.get(filterId)
+    if (filter) {
+      filter.cancel()
+      return { ok: true }
+    }
+    return { ok: false, message: 'Filter not found or already completed' }
+  })
+
+  /* ---- Scan files (sharing and archiving) ---- */
+
+  ipcMain.handle('export-scan', async (_event, rootPath: string, file: string) => {
+    await ensureShards()
+    const root = path.resolve(rootPath)
+    const shard = await shards.forPath(root)
+    let rows = 0
+    if (shard) {
+      shards.pin(shard.dbPath, 1)
+      try {
+        rows = await exportScanFile(shard.db, root, path.resolve(file))
+      } finally {
+        shards.pin(shard.dbPath, -1)
+      }
+    }
+    return rows ? { ok: true, rows } : { ok: false, message: `${root} has not been scanned` }
+  })
+
+  // Becomes the data of the file's root, as if it had been scanned here
+  ipcMain.handle('import-scan', async (_event, file: string) => {
+    await ensureShards()
+    const scanFile = openScanFile(file)
+    const shard = await shards.forScan(scanFile.rootPath)
+    shards.pin(shard.dbPath, 1)
+    try {
+      await scanFile.importInto(shard.db, shard.dbPath)
+    } finally {
+      shards.pin(shard.dbPath, -1)
+    }
+    await shards.refresh(shard.dbPath)
+    return { ok: true, rootPath: scanFile.rootPath, rows: scanFile.rows }
+  })
+
+  // Queries answered from the file's columns, without importing it
+  ipcMain.handle('scan-file-top', async (_event, file: string, req: ScanFileTopRequest) => {
+    return openScanFile(file).top(req.type, req.limit ?? 100, req.under)
+  })
+
+  ipcMain.handle('scan-file-children', async (_event, file: string, req: ChildRequest) => {
+    const scanFile = openScanFile(file)
+    if (req.parent === null) return { items: [scanFile.record(0)], total: 1 }
+    return scanFile.children(req.parent, req.limit ?? 200, req.includeFiles ?? true)
+  })
+
   /* ---- Drive enumeration ---- */
 
   ipcMain.handle('list-drives', async (): Promise<DriveInfo[]> => {
@@ -90,33 +230,61 @@ export function setupIpc(mainWindow: BrowserWindow) {
 
   /* ---- FS listing (immediate, no DB) ---- */
 
+  /** The archive read of the last listing; the next listing aborts it. */
+  let archiveRead: AbortController | null = null
+
   ipcMain.handle('list-dir', async (_event, dirPath: string): Promise<ListDirResponse> => {
+    archiveRead?.abort()
+    archiveRead = null
     const resolved = path.resolve(dirPath)
     const parentPath = path.dirname(resolved)
     const entries: ListDirEntry[] = []
+    const fsp = activeFsProvider()
     try {
-      const dirents = fs.readdirSync(resolved, { withFileTypes: true })
+      const dirents = fsp.readdirSync(resolved)
       for (const d of dirents) {
         const fullPath = path.join(resolved, d.name)
         try {
-          const s = fs.statSync(fullPath)
+          const s = fsp.statSync(fullPath)
           entries.push({
             name: d.name,
             isDirectory: d.isDirectory(),
             sizeBytes: d.isFile() ? s.size : 0,
-            lastWriteUtc: new Date(s.mtimeMs).toISOString()
+            lastWriteMs: Math.floor(s.mtimeMs),
+            isArchive: d.isFile() && isArchiveName(d.name) ? true : undefined
           })
         } catch {
           entries.push({
             name: d.name,
             isDirectory: d.isDirectory(),
             sizeBytes: 0,
-            lastWriteUtc: new Date().toISOString()
+            lastWriteMs: Date.now()
           })
         }
       }
     } catch {
-      /* inaccessible */
+      // Not a folder — maybe an archive, or a folder inside one
+      const inArchive = splitArchivePath(resolved)
+      if (inArchive) {
+        const read = new AbortController()
+        archiveRead = read
+        try {
+          const node = findArchiveNode(await readArchiveIndex(inArchive.archive, read.signal), inArchive.inner)
+          for (const c of node?.children?.values() ?? []) {
+            entries.push({
+              name: c.name,
+              isDirectory: c.isDirectory,
+              sizeBytes: c.sizeBytes,
+              lastWriteMs: c.mtimeMs,
+              compressedBytes: c.compressedBytes
+            })
+          }
+        } catch {
+          /* unreadable, corrupt, too large or superseded by a newer listing */
+        } finally {
+          if (archiveRead === read) archiveRead = null
+        }
+      }
     }
     return { entries, parentPath: parentPath === resolved ? null : parentPath }
   })
@@ -124,12 +292,14 @@ export function setupIpc(mainWindow: BrowserWindow) {
   /* ---- Scanning (non-blocking) ---- */
 
   ipcMain.handle('scan', async (_event, req: ScanRequest) => {
-    await ensureDb()
+    await ensureShards()
     const mode = req.mode ?? 'shallow'
 
     // For shallow scans (fast), run synchronously and return immediately
     if (mode === 'shallow') {
-      const runId = runScan({ startPath: req.startPath, db: dbHandle, dbPath })
+      const shard = await shards.forScan(path.resolve(req.startPath))
+      const runId = runScan({ startPath: req.startPath, db: shard.db, dbPath: shard.dbPath })
+      await shards.refresh(shard.dbPath)
       mainWindow.webContents.send('scan-status', {
         runId, state: 'completed', itemsScanned: 0
       } as ScanStatus)
@@ -155,19 +325,48 @@ export function setupIpc(mainWindow: BrowserWindow) {
         state: info.state,
         message: info.message,
         itemsScanned: info.itemsScanned,
+        bytesSeen: info.bytesSeen,
+        percent: info.percent,
+        etaSeconds: info.etaSeconds,
+        roots: info.roots,
         currentPath: info.currentPath
       } as ScanStatus)
     }
 
+    // Each root writes to its own shard, kept open until the scan ends
+    const targets = new Map<string, { db: any; dbPath: string }>()
+    for (const p of req.startPaths?.length ? req.startPaths : [req.startPath]) {
+      const root = path.resolve(p)
+      if (!targets.has(root)) targets.set(root, await shards.forScan(root))
+    }
+    const dbPaths = [...new Set([...targets.values()].map((t) => t.dbPath))]
+    for (const p of dbPaths) shards.pin(p, 1)
+    // Roots scanned apart below these lend their rows to an incremental scan
+    const nested = req.skipScannedAfter ? await shards.nestedIn([...targets.keys()]) : []
+    const first = targets.values().next().value!
+    const startedMs = Date.now()
+
     runScanAsync({
       startPath: req.startPath,
+      startPaths: req.startPaths,
       mode,
-      db: dbHandle,
-      dbPath,
+      db: first.db,
+      dbPath: first.dbPath,
+      shard: (root) => targets.get(root)!,
       runId,
       skipScannedAfter: req.skipScannedAfter,
+      elsewhere: shards.elsewhere(),
+      latencyMode: req.latencyMode,
+      fileRowBudget: req.fileRowBudget,
       onProgress: sendProgress
-    }).catch(() => { /* errors handled via onProgress */ })
+    }).catch(() => { /* errors handled via onProgress */ }).finally(async () => {
+      // The scan has saved its shards by now, cancelled or not
+      for (const p of nested) shards.pin(p, -1)
+      for (const p of dbPaths) {
+        shards.pin(p, -1)
+        await shards.refresh(p, startedMs)
+      }
+    }).catch((err) => console.error('Updating the shard catalog failed:', err))
 
     return { runId }
   })
@@ -184,10 +383,8 @@ export function setupIpc(mainWindow: BrowserWindow) {
   /* ---- Utility ---- */
 
   ipcMain.handle('reset-db', async () => {
-    await ensureDb()
-    const res = await resetDatabase(dbPath)
-    dbHandle = res.db
-    dbPath = res.dbPath
+    await ensureShards()
+    await shards.reset()
     return { ok: true }
   })
 
@@ -1,10 +1,19 @@
 import { app, BrowserWindow, dialog, Menu } from 'electron'
 import path from 'node:path'
-import { setupIpc } from './ipc'
+import { saveCatalog, setupIpc } from './ipc'
+import { whenAllDurable } from './db'
+import { nativeSqlite } from './sqlite'
 
-// Raise V8 heap limit to 4 GB for large scans (e.g. full C:\)
-// Also enable manual GC to help with memory spikes during sql.js exports
-app.commandLine.appendSwitch('js-flags', '--max-old-space-size=4096 --expose-gc')
+// Only the sql.js fallback holds the whole DB in memory: raise the V8 heap
+// limit to 4 GB for large scans (e.g. full C:\) and allow manual GC after
+// its exports. The native engine keeps the DB on disk and needs neither.
+if (!nativeSqlite()) app.commandLine.appendSwitch('js-flags', '--max-old-space-size=4096 --expose-gc')
+
+// Widen the libuv threadpool so the pipelined scanner can keep many stat
+// calls in flight on network mounts (default is 4). libuv sizes the pool
+// on its first use, which in the Electron main process comes after this
+// line; the 'libuv threadpool' smoke test checks that it took effect.
+process.env.UV_THREADPOOL_SIZE = process.env.UV_THREADPOOL_SIZE || '128'
 
 const isDev = process.env.NODE_ENV === 'development'
 process.env.VITE_PORT = process.env.VITE_PORT || '5173'
@@ -109,3 +118,19 @@ app.whenReady().then(() => {
 app.on('window-all-closed', () => {
   if (process.platform !== 'darwin') app.quit()
 })
+
+// Write queued rows and let background saves finish before the process goes away
+let savesFlushed = false
+app.on('will-quit', (event) => {
+  if (savesFlushed) return
+  event.preventDefault()
+  try {
+    saveCatalog()
+  } catch (err) {
+    console.error('Saving the shard catalog failed:', err)
+  }
+  whenAllDurable().finally(() => {
+    savesFlushed = true
+    app.quit()
+  })
+})
@@ -0,0 +1,164 @@
+import path from 'node:path'
+import { FsDir, FsEntry, FsIdStat, FsProvider, FsStat } from './fsprovider'
+
+/* ============================================================
+   Synthetic in-memory tree — deterministic, disk-free benchmarks
+   ============================================================ */
+
+/**
+ * A regular tree: every directory holds `files` files, and directories
+ * above `depth` also hold `fanout` subdirectories. Sizes and times are
+ * derived from a hash of the path, so every run sees the same tree.
+ */
+export interface SyntheticShape {
+  fanout: number
+  files: number
+  depth: number
+  seed?: number
+}
+
+/** Where the app mounts the synthetic tree (see activeFsProvider). */
+export const SYNTHETIC_ROOT = path.resolve(path.sep, 'lfb-synthetic')
+
+/** Parse "fanout,files,depth[,seed]"; null when unset or malformed. */
+export function parseSyntheticShape(spec?: string): SyntheticShape | null {
+  if (!spec) return null
+  const [fanout, files, depth, seed] = spec.split(',').map(Number)
+  if (![fanout, files, depth].every((n) => Number.isInteger(n) && n >= 0)) return null
+  return { fanout, files, depth, seed: Number.isInteger(seed) ? seed : undefined }
+}
+
+/** Files plus directories (including the root) in a synthetic tree. */
+export function syntheticEntryCount(shape: SyntheticShape): number {
+  let dirs = 0
+  for (let l = 0, n = 1; l <= shape.depth; l++, n *= shape.fanout) dirs += n
+  return dirs * (shape.files + 1)
+}
+
+/** Newest timestamp in the tree; everything else is up to a year older. */
+const BASE_MS = Date.UTC(2025, 0, 1)
+const YEAR_MS = 365 * 24 * 3600 * 1000
+
+function mix(h: number, x: number): number {
+  h = Math.imul(h ^ x, 0x85ebca6b) >>> 0
+  h ^= h >>> 13
+  h = Math.imul(h, 0xc2b2ae35) >>> 0
+  return (h ^ (h >>> 16)) >>> 0
+}
+
+class MemEntry implements FsEntry, FsStat {
+  constructor(
+    readonly name: string,
+    private readonly dir: boolean,
+    readonly size = 0,
+    readonly mtimeMs = 0
+  ) {}
+
+  isFile() {
+    return !this.dir
+  }
+
+  isDirectory() {
+    return this.dir
+  }
+}
+
+/** A path resolved against the shape: which node it is and its hash. */
+interface Node {
+  dir: boolean
+  level: number
+  /** Unique per directory; files add their index. */
+  ino: bigint
+  hash: number
+}
+
+function enoent(p: string): Error {
+  return Object.assign(new Error(`ENOENT: no such file or directory, '${p}'`), { code: 'ENOENT' })
+}
+
+/**
+ * Provider serving a synthetic tree at `root`. Nothing is stored: listings
+ * and stats are computed from the path, so a 10M-entry tree costs no memory.
+ */
+export function syntheticProvider(root: string, shape: SyntheticShape): FsProvider {
+  const { fanout, files, depth } = shape
+  const prefix = root.endsWith(path.sep) ? root : root + path.sep
+  const dirRadix = BigInt(fanout + 1)
+  const fileRadix = BigInt(files + 1)
+  const rootNode: Node = { dir: true, level: 0, ino: fileRadix, hash: mix(0x9e3779b9, shape.seed ?? 0) }
+
+  const resolve = (p: string): Node => {
+    if (p === root) return rootNode
+    if (!p.startsWith(prefix)) throw enoent(p)
+    const parts = p.slice(prefix.length).split(path.sep)
+    let dirId = 1n
+    let node = rootNode
+    for (let i = 0; i < parts.length; i++) {
+      const m = /^([df])(\d+)(\.bin)?$/.exec(parts[i])
+      if (!m) throw enoent(p)
+      const n = Number(m[2])
+      if (m[1] === 'd' && !m[3] && n < fanout && node.level < depth) {
+        dirId = dirId * dirRadix + BigInt(n + 1)
+        node = { dir: true, level: node.level + 1, ino: dirId * fileRadix, hash: mix(node.hash, n) }
+      } else if (m[1] === 'f' && m[3] && n < files && i === parts.length - 1) {
+        return { dir: false, level: node.level + 1, ino: node.ino + BigInt(n + 1), hash: mix(node.hash, 0x10000 + n) }
+      } else {
+        throw enoent(p)
+      }
+    }
+    return node
+  }
+
+  /** Log-uniform sizes from 1 B to 1 GB, like a real tree's long tail. */
+  const sizeOf = (n: Node) => (n.dir ? 0 : Math.floor(2 ** ((n.hash / 2 ** 32) * 30)))
+  const mtimeOf = (n: Node) => BASE_MS - Math.floor((mix(n.hash, 1) / 2 ** 32) * YEAR_MS)
+
+  const entryAt = (parent: Node, i: number): MemEntry | null => {
+    const dirs = parent.level < depth ? fanout : 0
+    if (i < dirs) return new MemEntry(`d${i}`, true)
+    if (i < dirs + files) return new MemEntry(`f${i - dirs}.bin`, false)
+    return null
+  }
+
+  const listSync = (dir: string): FsEntry[] => {
+    const node = resolve(dir)
+    if (!node.dir) throw enoent(dir)
+    const out: FsEntry[] = []
+    for (let i = 0, e = entryAt(node, 0); e; e = entryAt(node, ++i)) out.push(e)
+    return out
+  }
+
+  const statSync = (p: string): FsStat => {
+    const node = resolve(p)
+    return new MemEntry(path.basename(p), node.dir, sizeOf(node), mtimeOf(node))
+  }
+
+  const statBigSync = (p: string): FsIdStat => {
+    const node = resolve(p)
+    return { dev: 0x5e7n, ino: node.ino, mtimeMs: BigInt(mtimeOf(node)) }
+  }
+
+  /** Run `op` on a later tick, unless `signal` has aborted by then (rejects with its reason, as abortable() does). */
+  const later = <T>(op: () => T, signal?: AbortSignal): Promise<T> => Promise.resolve().then(() => {
+    signal?.throwIfAborted()
+    return op()
+  })
+
+  return {
+    readdirSync: listSync,
+    opendirSync: (dir): FsDir => {
+      const node = resolve(dir)
+      if (!node.dir) throw enoent(dir)
+      let i = 0
+      return {
+        readSync: () => entryAt(node, i++),
+        closeSync: () => { /* nothing held */ }
+      }
+    },
+    statSync,
+    statBigSync,
+    readdir: (dir, signal) => later(() => listSync(dir), signal),
+    stat: (p, signal) => later(() => statSync(p), signal),
+    statBig: (p, signal) => later(() => statBigSync(p), signal)
+  }
+}
@@ -0,0 +1,337 @@
+import fs from 'node:fs'
+import path from 'node:path'
+import { createHash } from 'node:crypto'
+import { Worker } from 'node:worker_threads'
+
+/* ============================================================
+   Dirty-page persistence — write only what changed since last save
+   ============================================================ */
+
+/** Journal header: magic, page size, dirty page count, new file length. */
+const HEADER_BYTES = 16
+/** Written last, once the journal body is on disk. */
+const COMMITTED = 0x4c46424a // 'LFBJ'
+
+/** Bytes of one page digest (SHA-1). */
+const DIGEST_BYTES = 20
+/** Pages hashed per read when learning a baseline from the file. */
+const READ_PAGES = 256
+
+/**
+ * What is known to be on disk, per database file (writer thread only): a
+ * digest per page rather than the image itself, which may be gigabytes.
+ */
+interface Baseline {
+  length: number
+  pageSize: number
+  digests: Buffer
+}
+
+const baselines = new Map<string, Baseline>()
+
+function journalPath(dbPath: string) {
+  return `${dbPath}-pj`
+}
+
+/** Page size from the SQLite file header (offset 16, big-endian; 1 = 64 KiB). */
+function pageSizeOf(image: Uint8Array): number {
+  if (image.length < 100) return 4096
+  const v = (image[16] << 8) | image[17]
+  return v === 1 ? 65536 : v || 4096
+}
+
+/** Size of the file at `p`, or -1 when there is none. */
+function fileSize(p: string): number {
+  try {
+    return fs.statSync(p).size
+  } catch {
+    return -1
+  }
+}
+
+/** A digest of every page of `image`, DIGEST_BYTES each. */
+function pageDigests(image: Uint8Array, pageSize: number): Buffer {
+  const count = Math.ceil(image.length / pageSize)
+  const digests = Buffer.allocUnsafe(count * DIGEST_BYTES)
+  for (let p = 0; p < count; p++) {
+    const page = image.subarray(p * pageSize, Math.min((p + 1) * pageSize, image.length))
+    createHash('sha1').update(page).digest().copy(digests, p * DIGEST_BYTES)
+  }
+  return digests
+}
+
+/** The baseline of the file at `dbPath`, read a few pages at a time; null if it has none. */
+function readBaseline(dbPath: string, length: number): Baseline | null {
+  const fd = fs.openSync(dbPath, 'r')
+  try {
+    const header = Buffer.alloc(100)
+    fs.readSync(fd, header, 0, header.length, 0)
+    const pageSize = pageSizeOf(header)
+    if (length % pageSize !== 0) return null
+    const digests = Buffer.allocUnsafe((length / pageSize) * DIGEST_BYTES)
+    const chunk = Buffer.allocUnsafe(READ_PAGES * pageSize)
+    for (let pos = 0; pos < length; pos += chunk.length) {
+      const n = fs.readSync(fd, chunk, 0, Math.min(chunk.length, length - pos), pos)
+      pageDigests(chunk.subarray(0, n), pageSize).copy(digests, (pos / pageSize) * DIGEST_BYTES)
+    }
+    return { length, pageSize, digests }
+  } finally {
+    fs.closeSync(fd)
+  }
+}
+
+/** Indexes of the pages whose digest in `next` differs from `prev`. */
+function dirtyPages(prev: Baseline, next: Buffer): number[] {
+  const pages: number[] = []
+  const count = next.length / DIGEST_BYTES
+  for (let p = 0; p < count; p++) {
+    const start = p * DIGEST_BYTES
+    const end = start + DIGEST_BYTES
+    if (end > prev.digests.length || prev.digests.compare(next, start, end, start, end) !== 0) pages.push(p)
+  }
+  return pages
+}
+
+function writeAll(fd: number, buf: Uint8Array, position: number) {
+  let done = 0
+  while (done < buf.length) done += fs.writeSync(fd, buf, done, buf.length - done, position + done)
+}
+
+/** Copy a committed journal's pages into the database file, then drop it. */
+function applyJournal(dbPath: string, journal: Buffer) {
+  const pageSize = journal.readUInt32LE(4)
+  const count = journal.readUInt32LE(8)
+  const length = journal.readUInt32LE(12) * pageSize
+  const fd = fs.openSync(dbPath, fs.existsSync(dbPath) ? 'r+' : 'w+')
+  try {
+    let p = HEADER_BYTES
+    for (let i = 0; i < count; i++) {
+      const page = journal.readUInt32LE(p)
+      writeAll(fd, journal.subarray(p + 4, p + 4 + pageSize), page * pageSize)
+      p += 4 + pageSize
+    }
+    fs.ftruncateSync(fd, length)
+    fs.fsyncSync(fd)
+  } finally {
+    fs.closeSync(fd)
+  }
+  fs.unlinkSync(journalPath(dbPath))
+}
+
+/**
+ * Finish or discard a save interrupted by a crash. A committed journal is
+ * replayed (the pages are idempotent); an uncommitted one never touched
+ * the database file and is simply removed.
+ */
+export function recoverJournal(dbPath: string) {
+  const jp = journalPath(dbPath)
+  if (!fs.existsSync(jp)) return
+  const journal = fs.readFileSync(jp)
+  if (journal.length >= HEADER_BYTES && journal.readUInt32LE(0) === COMMITTED) applyJournal(dbPath, journal)
+  else fs.unlinkSync(jp)
+}
+
+/** Write `image` to a temp file, fsync it, and rename it over `dbPath`. */
+function replaceFile(dbPath: string, image: Uint8Array) {
+  const tmp = `${dbPath}.tmp`
+  const fd = fs.openSync(tmp, 'w')
+  try {
+    writeAll(fd, image, 0)
+    fs.fsyncSync(fd)
+  } finally {
+    fs.closeSync(fd)
+  }
+  fs.renameSync(tmp, dbPath)
+}
+
+/**
+ * Bring the file at `dbPath` up to `image`. With a known on-disk baseline
+ * only the changed pages are written, through a redo journal: the pages
+ * are made durable in `<db>-pj` first, marked committed, then copied into
+ * place. Without one, the whole image replaces the file atomically.
+ *
+ * The saving is in disk I/O only. sql.js cannot report which pages a
+ * transaction touched, so every save still exports the whole image and
+ * hashes it page by page, on the writer thread.
+ */
+export function writeImage(dbPath: string, image: Uint8Array) {
+  const onDisk = fileSize(dbPath)
+  let prev = baselines.get(dbPath)
+  // Someone else replaced or removed the file: re-learn what is there
+  if (prev && prev.length !== onDisk) prev = undefined
+  if (!prev && onDisk > 0) prev = readBaseline(dbPath, onDisk) ?? undefined
+  const pageSize = pageSizeOf(image)
+  const digests = pageDigests(image, pageSize)
+  if (!prev || prev.pageSize !== pageSize || image.length % pageSize !== 0) {
+    replaceFile(dbPath, image)
+    baselines.set(dbPath, { length: image.length, pageSize, digests })
+    return
+  }
+
+  const pages = dirtyPages(prev, digests)
+  if (pages.length === 0 && prev.length === image.length) return
+
+  const journal = Buffer.allocUnsafe(HEADER_BYTES + pages.length * (4 + pageSize))
+  journal.writeUInt32LE(0, 0)
+  journal.writeUInt32LE(pageSize, 4)
+  journal.writeUInt32LE(pages.length, 8)
+  journal.writeUInt32LE(image.length / pageSize, 12)
+  let p = HEADER_BYTES
+  for (const page of pages) {
+    journal.writeUInt32LE(page, p)
+    journal.set(image.subarray(page * pageSize, (page + 1) * pageSize), p + 4)
+    p += 4 + pageSize
+  }
+
+  const jfd = fs.openSync(journalPath(dbPath), 'w')
+  try {
+    writeAll(jfd, journal, 0)
+    fs.fsyncSync(jfd)
+    journal.writeUInt32LE(COMMITTED, 0)
+    writeAll(jfd, journal.subarray(0, 4), 0)
+    fs.fsyncSync(jfd)
+  } finally {
+    fs.closeSync(jfd)
+  }
+  applyJournal(dbPath, journal)
+  baselines.set(dbPath, { length: image.length, pageSize, digests })
+}
+
+/* ============================================================
+   Background writer — saves off the main thread, coalesced
+   ============================================================ */
+
+interface PersistState {
+  writing: boolean
+  /** Newest image waiting for the writer; older ones are superseded. */
+  pending: Uint8Array | null
+  /** Exports the database afresh, to redo a save the writer lost; null when idle. */
+  exportImage: (() => Uint8Array) | null
+  idle: (() => void)[]
+}
+
+const states = new Map<string, PersistState>()
+const savedListeners: ((dbPath: string, savedAt: number) => void)[] = []
+let worker: Worker | null = null
+/** Set once the writer has died; later saves run on this thread. */
+let inProcess = false
+
+/** Called with the time each save became durable. */
+export function onPersisted(listener: (dbPath: string, savedAt: number) => void) {
+  savedListeners.push(listener)
+}
+
+/** Report a save that needed no writer (native engine commits). */
+export function markPersisted(dbPath: string, savedAt = Date.now()) {
+  for (const l of savedListeners) l(dbPath, savedAt)
+}
+
+function writer(): Worker {
+  if (!worker) {
+    const w = new Worker(path.join(__dirname, 'persistWorker.js'))
+    w.on('message', (msg: { dbPath: string; savedAt?: number; error?: string }) => {
+      if (msg.error) console.error(`Saving ${msg.dbPath} failed: ${msg.error}`)
+      else markPersisted(msg.dbPath, msg.savedAt)
+      const st = states.get(msg.dbPath)!
+      st.writing = false
+      pump(msg.dbPath, st)
+    })
+    w.on('error', (err) => writerDied(w, err))
+    w.on('exit', (code) => writerDied(w, new Error(`exited with code ${code}`)))
+    worker = w
+  }
+  return worker
+}
+
+/**
+ * The writer crashed or exited: finish its saves here and keep saving on
+ * this thread, so waiters (quit among them) still settle.
+ */
+function writerDied(w: Worker, err: Error) {
+  // 'error' is followed by 'exit'; handle the first only
+  if (worker !== w) return
+  worker = null
+  inProcess = true
+  console.error(`Background writer failed, saving in process: ${err.message}`)
+  for (const [dbPath, st] of states) {
+    if (!st.writing) continue
+    st.writing = false
+    // A newer pending image supersedes the lost one; else export again
+    try {
+      st.pending ??= st.exportImage?.() ?? null
+    } catch (err: any) {
+      console.error(`Saving ${dbPath} failed: ${err?.message ?? err}`)
+    }
+    pump(dbPath, st)
+  }
+}
+
+/** Save `image` on this thread, finishing any journal the writer left. */
+function saveInProcess(dbPath: string, image: Uint8Array) {
+  try {
+    recoverJournal(dbPath)
+    writeImage(dbPath, image)
+    markPersisted(dbPath)
+  } catch (err: any) {
+    console.error(`Saving ${dbPath} failed: ${err?.message ?? err}`)
+  }
+}
+
+/** Keep the process alive only while some save is in flight. */
+function updateRef() {
+  if (!worker) return
+  let busy = false
+  for (const st of states.values()) busy ||= st.writing
+  if (busy) worker.ref()
+  else worker.unref()
+}
+
+function pump(dbPath: string, st: PersistState) {
+  const image = st.pending
+  if (!image) {
+    // Nothing left to redo; don't hold on to the database
+    st.exportImage = null
+    updateRef()
+    for (const resolve of st.idle.splice(0)) resolve()
+    return
+  }
+  st.pending = null
+  if (inProcess) {
+    saveInProcess(dbPath, image)
+    pump(dbPath, st)
+    return
+  }
+  st.writing = true
+  // Handed over, not copied: a lost save is redone from a fresh export
+  const whole = image.byteOffset === 0 && image.byteLength === image.buffer.byteLength
+  writer().postMessage({ dbPath, image }, whole ? [image.buffer as ArrayBuffer] : [])
+  updateRef()
+}
+
+/**
+ * Queue the image `exportImage` returns to be written to `dbPath` by the
+ * background writer and return at once. While a write is in flight only
+ * the newest image is kept; `exportImage` is called again should the
+ * writer die with a save unfinished.
+ */
+export function persistImage(dbPath: string, exportImage: () => Uint8Array) {
+  let st = states.get(dbPath)
+  if (!st) {
+    st = { writing: false, pending: null, exportImage, idle: [] }
+    states.set(dbPath, st)
+  }
+  st.exportImage = exportImage
+  st.pending = exportImage()
+  if (!st.writing) pump(dbPath, st)
+}
+
+/** Resolves once every queued save (of `dbPath`, or of all files) is on disk. */
+export function whenPersisted(dbPath?: string): Promise<void> {
+  const waits: Promise<void>[] = []
+  for (const [p, st] of states) {
+    if ((dbPath === undefined || p === dbPath) && (st.writing || st.pending)) {
+      waits.push(new Promise((resolve) => st.idle.push(resolve)))
+    }
+  }
+  return Promise.all(waits).then(() => undefined)
+}
@@ -0,0 +1,17 @@
+import { parentPort } from 'node:worker_threads'
+import { writeImage } from './persist'
+
+/* ============================================================
+   Persistence worker — runs writeImage off the main thread
+   ============================================================ */
+
+parentPort!.on('message', ({ dbPath, image }: { dbPath: string; image: Uint8Array }) => {
+  // Test hook: die mid-save, as a worker out of memory would
+  if (process.env.LFB_PERSIST_WORKER === 'crash') process.exit(1)
+  try {
+    writeImage(dbPath, image)
+    parentPort!.postMessage({ dbPath, savedAt: Date.now() })
+  } catch (err: any) {
+    parentPort!.postMessage({ dbPath, error: String(err?.message ?? err) })
+  }
+})
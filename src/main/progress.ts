@@ -0,0 +1,95 @@
+import fs from 'node:fs'
+import path from 'node:path'
+import { getItemByPath, getKnownTotals } from './db'
+
+/* ============================================================
+   Scan progress estimation — percent complete & ETA
+   ============================================================ */
+
+/** How much a scan is expected to cover. Zero means unknown. */
+export interface ScanTotals {
+  items: number
+  bytes: number
+}
+
+/**
+ * Expected totals for a full scan of `root`. A previous complete scan of
+ * the same folder is the best guide. Otherwise the folders below it that
+ * earlier (or cancelled) scans did finish add up to a lower bound. For a
+ * volume root statfs gives the used bytes and inodes, which is better
+ * than a partial sum.
+ */
+export function expectedTotals(db: any, root: string): ScanTotals | null {
+  const prev = getItemByPath(db, root)
+  if (prev && prev.type === 'Folder' && prev.scannedMs) {
+    return { items: prev.fileCount + prev.folderCount, bytes: prev.sizeBytes }
+  }
+  if (path.dirname(root) !== root) return getKnownTotals(db, root)
+  try {
+    const s = fs.statfsSync(root)
+    // Windows reports no inode counts; bytes alone still give a percentage
+    return {
+      items: s.files > 0 ? s.files - s.ffree : 0,
+      bytes: (s.blocks - s.bfree) * s.bsize
+    }
+  } catch {
+    return null
+  }
+}
+
+/** Minimum spacing (ms) between throughput samples. */
+const SAMPLE_MS = 500
+
+/** Weight of the newest throughput sample in the moving average. */
+const SMOOTHING = 0.2
+
+/** Never claim more than this until the walk actually finishes. */
+const MAX_RUNNING_FRACTION = 0.99
+
+export interface ScanEstimate {
+  percent?: number
+  etaSeconds?: number
+}
+
+/**
+ * Turns items and bytes seen so far into a percentage, and a remaining-time
+ * estimate from an exponentially smoothed completion rate.
+ */
+export class ScanEstimator {
+  private fraction = 0
+  private sampleFraction = 0
+  private sampleAt: number
+  /** Smoothed completion rate, fraction per ms. */
+  private rate = 0
+
+  constructor(private totals: ScanTotals | null, now = performance.now()) {
+    this.sampleAt = now
+  }
+
+  update(items: number, bytes: number, now = performance.now()): ScanEstimate {
+    const t = this.totals
+    if (!t || (t.items <= 0 && t.bytes <= 0)) return {}
+
+    // Average the sources we have; either alone can be skewed by a few
+    // huge files or by millions of empty ones.
+    let sum = 0
+    let n = 0
+    if (t.items > 0) { sum += items / t.items; n++ }
+    if (t.bytes > 0) { sum += bytes / t.bytes; n++ }
+    // Stay monotonic — totals are estimates and the tree may have grown
+    this.fraction = Math.max(this.fraction, Math.min(MAX_RUNNING_FRACTION, sum / n))
+
+    const dt = now - this.sampleAt
+    if (dt >= SAMPLE_MS) {
+      const inst = (this.fraction - this.sampleFraction) / dt
+      this.rate = this.rate > 0 ? this.rate + SMOOTHING * (inst - this.rate) : inst
+      this.sampleFraction = this.fraction
+      this.sampleAt = now
+    }
+
+    return {
+      percent: Math.round(this.fraction * 1000) / 10,
+      etaSeconds: this.rate > 0 ? Math.round((1 - this.fraction) / this.rate / 1000) : undefined
+    }
+  }
+}
@@ -0,0 +1,127 @@
+/* ============================================================
+   File retention — which individual files get a DB row
+   ============================================================ */
+
+/**
+ * Bounded min-heap keeping the K largest files of one folder. Backed by
+ * preallocated arrays so offering a file never allocates.
+ */
+export class FileHeap {
+  readonly sizes: Float64Array
+  readonly mtimes: Float64Array
+  readonly names: string[]
+  count = 0
+
+  constructor(readonly capacity: number) {
+    this.sizes = new Float64Array(capacity)
+    this.mtimes = new Float64Array(capacity)
+    this.names = new Array<string>(capacity).fill('')
+  }
+
+  /** Keep the file if it is among the K largest seen so far. */
+  offer(name: string, sizeBytes: number, mtimeMs: number) {
+    if (this.count < this.capacity) {
+      this.place(this.count++, name, sizeBytes, mtimeMs)
+      this.siftUp(this.count - 1)
+    } else if (this.capacity > 0 && sizeBytes > this.sizes[0]) {
+      this.place(0, name, sizeBytes, mtimeMs)
+      this.siftDown(0)
+    }
+  }
+
+  clear() {
+    this.names.fill('', 0, this.count)
+    this.count = 0
+  }
+
+  private place(i: number, name: string, sizeBytes: number, mtimeMs: number) {
+    this.names[i] = name
+    this.sizes[i] = sizeBytes
+    this.mtimes[i] = mtimeMs
+  }
+
+  private swap(i: number, j: number) {
+    const n = this.names[i]
+    const s = this.sizes[i]
+    const m = this.mtimes[i]
+    this.place(i, this.names[j], this.sizes[j], this.mtimes[j])
+    this.place(j, n, s, m)
+  }
+
+  private siftUp(i: number) {
+    while (i > 0) {
+      const up = (i - 1) >> 1
+      if (this.sizes[up] <= this.sizes[i]) return
+      this.swap(i, up)
+      i = up
+    }
+  }
+
+  private siftDown(i: number) {
+    for (;;) {
+      const l = 2 * i + 1
+      const r = l + 1
+      let min = i
+      if (l < this.count && this.sizes[l] < this.sizes[min]) min = l
+      if (r < this.count && this.sizes[r] < this.sizes[min]) min = r
+      if (min === i) return
+      this.swap(i, min)
+      i = min
+    }
+  }
+}
+
+/** Heaps are recycled between folders; a scan only holds one per open dir. */
+export class FileHeapPool {
+  private free: FileHeap[] = []
+
+  constructor(readonly perFolder: number) {}
+
+  acquire(): FileHeap {
+    return this.free.pop() ?? new FileHeap(this.perFolder)
+  }
+
+  release(h: FileHeap) {
+    h.clear()
+    this.free.push(h)
+  }
+}
+
+/** Power-of-two size classes: bucket 0 holds 0 bytes, bucket b holds [2^(b-1), 2^b). */
+const BUCKETS = 64
+
+function bucketOf(sizeBytes: number): number {
+  if (sizeBytes < 1) return 0
+  return Math.min(BUCKETS - 1, Math.floor(Math.log2(sizeBytes)) + 1)
+}
+
+/**
+ * Global minimum file size for a DB row, raised as the scan goes so that
+ * no more than `budget` file rows are kept. Tracks admitted rows in a
+ * log2 size histogram; when the budget overflows, whole size classes are
+ * dropped from the bottom. Rows admitted before a raise are pruned once
+ * the scan ends (see pruneSmallFiles in db.ts).
+ */
+export class SizeThreshold {
+  private counts = new Float64Array(BUCKETS)
+  private lowest = 0
+  kept = 0
+  /** Files smaller than this are no longer stored. */
+  minBytes = 0
+
+  constructor(readonly budget: number) {}
+
+  /** Count a file row that is about to be written; false if it is too small. */
+  admit(sizeBytes: number): boolean {
+    if (sizeBytes < this.minBytes) return false
+    this.counts[bucketOf(sizeBytes)]++
+    this.kept++
+    while (this.kept > this.budget && this.lowest < BUCKETS - 1) {
+      this.kept -= this.counts[this.lowest]
+      this.counts[this.lowest] = 0
+      this.lowest++
+      this.minBytes = 2 ** (this.lowest - 1)
+    }
+    return sizeBytes >= this.minBytes
+  }
+}
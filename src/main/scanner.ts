@@ -1,7 +1,9 @@
-import fs from 'node:fs'
 import path from 'node:path'
-import { ItemRecord } from '../shared/types'
-import { upsertItems, persistDatabase, getItemByPath } from './db'
+import { ItemRecord, LatencyMode, RootProgress } from '../shared/types'
+import { ItemBatch, upsertItems, upsertBatch, flushWrites, persistDatabase, getItemByPath, getFolderByInode, moveSubtree, copySubtree, removeSubtree, getSubtreeFolders, markUnscanned, pruneSmallFiles, recordSnapshot, registerRoot } from './db'
+import { FsDir, FsEntry, FsIdStat, FsProvider, FsStat, activeFsProvider } from './fsprovider'
+import { FileHeap, FileHeapPool, SizeThreshold } from './retention'
+import { ScanEstimator, expectedTotals } from './progress'
 import { randomUUID } from 'node:crypto'
 
 /* ============================================================
@@ -10,11 +12,41 @@ import { randomUUID } from 'node:crypto'
 
 interface ScanOptions {
   startPath: string
+  /** Several roots for one full scan; startPath is used when absent. */
+  startPaths?: string[]
+  /** Read from this provider instead of the app's (benchmarks, tests). */
+  fs?: FsProvider
   mode: 'full' | 'shallow'
   db: any
   dbPath: string
-  /** Skip directories already deep-scanned after this ISO date. */
-  skipScannedAfter?: string
+  /** Database holding each root's rows; `db` holds them all when absent. */
+  shard?: (root: string) => { db: any; dbPath: string }
+  /** Skip directories already deep-scanned after this time (epoch ms). */
+  skipScannedAfter?: number
+  /** Other databases whose rows an incremental scan may take over. */
+  elsewhere?: Elsewhere
+  /** Metadata latency profile; 'auto' (default) probes the first few calls. */
+  latencyMode?: LatencyMode
+  /** Most file rows one full scan may keep (default FILE_ROW_BUDGET). */
+  fileRowBudget?: number
+}
+
+/** A database handle, as the scan writes to or reads from it. */
+interface DbHandle {
+  db: any
+  dbPath: string
+}
+
+/**
+ * Where an incremental scan looks for rows its own database lacks: the
+ * other shards, which hold the roots scanned apart from this one.
+ */
+export interface Elsewhere {
+  /** The open database other than `db` holding the rows of `p`, if any. */
+  holder(p: string, db: any): DbHandle | null
+  /** A folder row with this identity in a database other than `db`; that database stays open until release(). */
+  byInode(dev: string, ino: string, db: any): Promise<(DbHandle & { row: ItemRecord }) | null>
+  release(dbPath: string): void
 }
 
 export interface AsyncScanOptions extends ScanOptions {
@@ -22,6 +54,8 @@ export interface AsyncScanOptions extends ScanOptions {
   onProgress?: (info: ScanProgress) => void
   /** If this returns true the scan is aborted. */
   isCancelled?: () => boolean
+  /** Aborts the scan, including metadata requests already in flight. */
+  signal?: AbortSignal
   /** Optional pre-generated runId. */
   runId?: string
 }
@@ -29,6 +63,13 @@ export interface AsyncScanOptions extends ScanOptions {
 export interface ScanProgress {
   runId: string
   itemsScanned: number
+  /** Bytes covered so far, including subtrees reused from earlier scans. */
+  bytesSeen?: number
+  /** Estimated completion (0–100); absent when there is nothing to go by. */
+  percent?: number
+  etaSeconds?: number
+  /** Per-root breakdown, present when the scan has more than one root. */
+  roots?: RootProgress[]
   currentPath: string
   state: 'running' | 'completed' | 'error' | 'cancelled'
   message?: string
@@ -45,7 +86,7 @@ function fsParent(p: string): string | null {
 }
 
 /** Quick stat of a directory's immediate file contents (no recursion). */
-function statDirShallow(dirPath: string): {
+function statDirShallow(fsp: FsProvider, dirPath: string): {
   sizeBytes: number
   fileCount: number
   folderCount: number
@@ -56,11 +97,11 @@ function statDirShallow(dirPath: string): {
     folderCount = 0,
     latestMs = 0
   try {
-    const entries = fs.readdirSync(dirPath, { withFileTypes: true })
+    const entries = fsp.readdirSync(dirPath)
     for (const e of entries) {
       if (e.isFile()) {
         try {
-          const s = fs.statSync(path.join(dirPath, e.name))
+          const s = fsp.statSync(path.join(dirPath, e.name))
           sizeBytes += s.size
           fileCount++
           latestMs = Math.max(latestMs, s.mtimeMs)
@@ -86,12 +127,12 @@ function yieldToEventLoop(): Promise<void> {
    Shallow scan (synchronous — fast enough for a single dir)
    ============================================================ */
 
-function scanShallow(startPath: string, runId: string): ItemRecord[] {
+function scanShallow(fsp: FsProvider, startPath: string, runId: string): ItemRecord[] {
   const root = path.resolve(startPath)
   const items: ItemRecord[] = []
-  let entries: fs.Dirent[]
+  let entries: FsEntry[]
   try {
-    entries = fs.readdirSync(root, { withFileTypes: true })
+    entries = fsp.readdirSync(root)
   } catch {
     return items
   }
@@ -105,7 +146,7 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
     const childPath = path.join(root, e.name)
     if (e.isFile()) {
       try {
-        const s = fs.statSync(childPath)
+        const s = fsp.statSync(childPath)
         totalSize += s.size
         totalFiles++
         latest = Math.max(latest, s.mtimeMs)
@@ -116,8 +157,8 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
           sizeBytes: s.size,
           fileCount: 1,
           folderCount: 0,
-          lastWriteUtc: new Date(s.mtimeMs).toISOString(),
-          scannedUtc: '',
+          lastWriteMs: Math.floor(s.mtimeMs),
+          scannedMs: 0,
           depth: 1,
           runId
         })
@@ -125,7 +166,7 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
         continue
       }
     } else if (e.isDirectory()) {
-      const di = statDirShallow(childPath)
+      const di = statDirShallow(fsp, childPath)
       totalSize += di.sizeBytes
       totalFolders++
       latest = Math.max(latest, di.latestMs)
@@ -136,8 +177,8 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
         sizeBytes: di.sizeBytes,
         fileCount: di.fileCount,
         folderCount: di.folderCount,
-        lastWriteUtc: new Date(di.latestMs || Date.now()).toISOString(),
-        scannedUtc: '',
+        lastWriteMs: Math.floor(di.latestMs || Date.now()),
+        scannedMs: 0,
         depth: 1,
         runId
       })
@@ -146,7 +187,7 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
 
   // Record the root folder itself
   try {
-    const rs = fs.statSync(root)
+    const rs = fsp.statSync(root)
     latest = Math.max(latest, rs.mtimeMs)
   } catch {
     /* ignore */
@@ -158,8 +199,8 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
     sizeBytes: totalSize,
     fileCount: totalFiles,
     folderCount: totalFolders,
-    lastWriteUtc: new Date(latest || Date.now()).toISOString(),
-    scannedUtc: '',
+    lastWriteMs: Math.floor(latest || Date.now()),
+    scannedMs: 0,
     depth: 0,
     runId
   })
@@ -168,7 +209,7 @@ function scanShallow(startPath: string, runId: string): ItemRecord[] {
 }
 
 /* ============================================================
-   Full recursive scan — async with periodic yielding
+   Full recursive scan — shared state & helpers
    ============================================================ */
 
 interface AggResult {
@@ -178,181 +219,684 @@ interface AggResult {
   latestMs: number
 }
 
+/** State shared by every directory visited during one full scan. */
+interface ScanContext {
+  runId: string
+  db: any
+  dbPath: string
+  fs: FsProvider
+  counter: {
+    count: number
+    lastYield: number
+    lastYieldAt: number
+    lastPersist: number
+    /** Items and bytes covered, for the estimate; reused subtrees count too. */
+    covered: number
+    bytes: number
+  }
+  estimate: ScanEstimator
+  onProgress?: (info: ScanProgress) => void
+  /** Aborted on cancel; passed to every async fs call of the scan. */
+  signal: AbortSignal
+  isCancelled: () => boolean
+  skipScannedAfter?: number
+  elsewhere?: Elsewhere
+  /** Pending rows, shared by every directory and reused across flushes. */
+  batch: ItemBatch
+  /** In-flight request slots, shared by all roots of the scan. */
+  pool: RequestPool
+  /** Per-folder top-K heaps for the directories currently open. */
+  heaps: FileHeapPool
+  threshold: SizeThreshold
+}
+
 /** How often (in items) to yield to the event loop & send progress. */
 const YIELD_INTERVAL = 200
 
-/** How often (in items) to persist the DB to disk (frees sql.js write buffers).
- * Reduced from 5_000 to 50_000 to prevent memory spikes from Uint8Array allocations. */
+/**
+ * Longest stretch (ms) between yields regardless of item count. A cancel
+ * request is an IPC message, so this bounds how long it waits to be seen.
+ */
+const YIELD_MS = 25
+
+/**
+ * How often (in items) to checkpoint the DB mid-scan: a WAL checkpoint for
+ * native SQLite, a background dirty-page save for sql.js. Each sql.js save
+ * still exports the whole image, so keep them far apart.
+ */
 const PERSIST_INTERVAL = 50_000
 
 /**
- * Minimum file size (bytes) to store as an individual DB record.
- * Smaller files still count toward their parent folder's totals.
- * This dramatically reduces memory for full-drive scans where millions
- * of tiny files would otherwise bloat the in-memory sql.js database.
+ * Largest files stored as individual DB records per folder. The rest
+ * still count toward their parent folder's totals.
  */
-const MIN_FILE_SIZE_FOR_DB = 100 * 1024 // 100 KB
+const FILES_PER_FOLDER = 50
 
 /**
- * Async full recursive scan. Yields control to the event loop every
- * YIELD_INTERVAL items so IPC / rendering stays responsive.
+ * Default cap on file rows per full scan. Once reached, the global minimum
+ * file size rises so the in-memory sql.js database stays bounded whether
+ * the tree holds millions of tiny files or a few huge ones.
  */
-async function scanFullAsync(
+const FILE_ROW_BUDGET = 250_000
+
+function emptyAgg(): AggResult {
+  return { sizeBytes: 0, fileCount: 0, folderCount: 0, latestMs: 0 }
+}
+
+/** Count a file toward the scan-wide progress totals. */
+function countFile(ctx: ScanContext, sizeBytes: number) {
+  ctx.counter.count++
+  ctx.counter.covered++
+  ctx.counter.bytes += sizeBytes
+}
+
+/** Count a subtree reused from an earlier scan toward progress. */
+function countReused(ctx: ScanContext, agg: AggResult) {
+  ctx.counter.covered += agg.fileCount + agg.folderCount + 1
+  ctx.counter.bytes += agg.sizeBytes
+}
+
+/** Fold a finished child directory into its parent's totals. */
+function addChildAgg(agg: AggResult, sub: AggResult) {
+  agg.sizeBytes += sub.sizeBytes
+  agg.fileCount += sub.fileCount
+  agg.folderCount += sub.folderCount + 1
+  agg.latestMs = Math.max(agg.latestMs, sub.latestMs)
+}
+
+/** Child path of an already-resolved dir; path.join would re-normalize it. */
+function childOf(dir: string, name: string): string {
+  return dir.endsWith(path.sep) ? dir + name : dir + path.sep + name
+}
+
+/** Remember a file if it may be among its folder's largest. */
+function offerFile(ctx: ScanContext, heap: FileHeap, name: string, s: FsStat) {
+  if (s.size >= ctx.threshold.minBytes) heap.offer(name, s.size, s.mtimeMs)
+}
+
+/** Queue rows for a folder's retained files and return its heap to the pool. */
+function keepFiles(ctx: ScanContext, heap: FileHeap, dirPath: string, depth: number) {
+  for (let i = 0; i < heap.count; i++) {
+    if (!ctx.threshold.admit(heap.sizes[i])) continue
+    ctx.batch.pushFile(childOf(dirPath, heap.names[i]), dirPath, depth + 1, ctx.runId, heap.sizes[i], heap.mtimes[i], true)
+    if (ctx.batch.full) flushBatch(ctx)
+  }
+  ctx.heaps.release(heap)
+}
+
+/**
+ * Queue a folder row; only mark it as scanned when its subtree was fully
+ * walked. With `sweep` (the listing was read to the end) its child rows
+ * this run did not write are deleted once the row lands.
+ */
+function pushFolder(
+  ctx: ScanContext,
   dirPath: string,
   depth: number,
-  runId: string,
-  db: any,
-  dbPath: string,
-  counter: { count: number; lastYield: number },
-  onProgress?: (info: ScanProgress) => void,
-  isCancelled?: () => boolean,
-  skipScannedAfter?: string
-): Promise<AggResult> {
-  if (isCancelled?.()) {
-    return { sizeBytes: 0, fileCount: 0, folderCount: 0, latestMs: 0 }
+  agg: AggResult,
+  complete: boolean,
+  id: FsIdStat | null,
+  sweep = false
+) {
+  ctx.batch.pushFolder(dirPath, fsParent(dirPath), depth, ctx.runId, agg, complete, id, sweep)
+  if (ctx.batch.full) flushBatch(ctx)
+}
+
+/**
+ * Claim a subtree reused from an earlier scan for this run, so its
+ * parent's sweep keeps it. Its scannedMs and identity stay as recorded.
+ */
+function keepReused(ctx: ScanContext, dirPath: string, depth: number, agg: AggResult) {
+  pushFolder(ctx, dirPath, depth, agg, false, null)
+}
+
+function flushBatch(ctx: ScanContext) {
+  upsertBatch(ctx.db, ctx.dbPath, ctx.batch)
+}
+
+function recordAgg(r: ItemRecord): AggResult {
+  return {
+    sizeBytes: r.sizeBytes,
+    fileCount: r.fileCount,
+    folderCount: r.folderCount,
+    latestMs: r.lastWriteMs
   }
+}
 
-  const resolved = path.resolve(dirPath)
-  let entries: fs.Dirent[]
+/** Cached totals if `existing` was deep-scanned after the cutoff, or null. */
+function cachedDirAgg(ctx: ScanContext, existing: ItemRecord | null): AggResult | null {
+  if (ctx.skipScannedAfter && existing && existing.scannedMs && existing.scannedMs >= ctx.skipScannedAfter) {
+    return recordAgg(existing)
+  }
+  return null
+}
+
+/**
+ * The committed row of `dirPath`. When this scan's database has none but
+ * another one (a root scanned apart, below this one) holds a subtree recent
+ * enough to reuse, that subtree is copied over first, so the reuse does not
+ * depend on the other database staying around.
+ */
+function existingRow(ctx: ScanContext, dirPath: string, depth: number): ItemRecord | null {
+  const own = getItemByPath(ctx.db, dirPath)
+  if (own) return own
+  const other = ctx.elsewhere?.holder(dirPath, ctx.db)
+  if (!other) return null
+  const row = getItemByPath(other.db, dirPath)
+  if (!row || !cachedDirAgg(ctx, row)) return null
+  copySubtree(other.db, ctx.db, dirPath, dirPath, depth - row.depth)
+  return row
+}
+
+/** True when `p` is still the directory `id` identifies. */
+async function sameDir(ctx: ScanContext, p: string, id: FsIdStat): Promise<boolean> {
   try {
-    entries = fs.readdirSync(resolved, { withFileTypes: true })
+    const o = await ctx.fs.statBig(p, ctx.signal)
+    return o.dev === id.dev && o.ino === id.ino
   } catch {
-    return { sizeBytes: 0, fileCount: 0, folderCount: 0, latestMs: 0 }
+    return false
   }
+}
 
-  const batchItems: ItemRecord[] = []
-  let totalSize = 0,
-    totalFiles = 0,
-    totalFolders = 0,
-    latest = 0
+/** Directory stats issued at once while verifying a moved subtree. */
+const VERIFY_BATCH = 64
+
+/**
+ * Incremental scans only: `dirPath` has no row, but its (dev, ino) may be
+ * a folder we already know under another path — i.e. it was renamed or
+ * moved. Re-key the cached subtree in bulk so no orphans stay behind (or
+ * bring it over from the shard that held it), then reuse its totals if
+ * every folder's own mtime is unchanged. Returns null when the directory
+ * still has to be walked.
+ */
+async function adoptMovedDir(ctx: ScanContext, dirPath: string, depth: number): Promise<AggResult | null> {
+  let id: FsIdStat
+  try {
+    id = await ctx.fs.statBig(dirPath, ctx.signal)
+  } catch {
+    return null
+  }
+  let old = getFolderByInode(ctx.db, String(id.dev), String(id.ino))
+  // Moved out of another shard's root: its rows come over with it
+  const from = old || !ctx.elsewhere ? null : await ctx.elsewhere.byInode(String(id.dev), String(id.ino), ctx.db)
+  if (from) old = from.row
+  // Still reachable at the old path (junction, bind mount) — not a move
+  const moved = !!old && old.path !== dirPath && !(await sameDir(ctx, old.path, id))
+  if (from) {
+    if (old && moved) {
+      copySubtree(from.db, ctx.db, old.path, dirPath, depth - old.depth)
+      removeSubtree(from.db, old.path)
+      persistDatabase(from.db, from.dbPath)
+    }
+    ctx.elsewhere!.release(from.dbPath)
+  }
+  if (!old || !moved) return null
+  if (!from) moveSubtree(ctx.db, old.path, dirPath, depth - old.depth)
+  if (!old.scannedMs) return null
+
+  const folders = getSubtreeFolders(ctx.db, dirPath)
+  const changed: string[] = []
+  for (let i = 0; i < folders.length; i += VERIFY_BATCH) {
+    const chunk = folders.slice(i, i + VERIFY_BATCH)
+    const same = await Promise.all(chunk.map((f) =>
+      ctx.fs.statBig(f.path, ctx.signal).then((s) => Number(s.mtimeMs) === f.dirMtimeMs, () => false)
+    ))
+    chunk.forEach((f, j) => { if (!same[j]) changed.push(f.path) })
+  }
+  if (changed.length === 0) return recordAgg(old)
+
+  // Changed folders and their ancestors lose their scanned mark, so the
+  // walk that follows rescans them and reuses every untouched sibling.
+  const stale = new Set<string>()
+  for (const c of changed) {
+    let p: string | null = c
+    while (p && p.startsWith(dirPath) && !stale.has(p)) {
+      stale.add(p)
+      p = fsParent(p)
+    }
+  }
+  markUnscanned(ctx.db, [...stale])
+  return null
+}
+
+/** True once YIELD_INTERVAL items or YIELD_MS have passed since the last checkpoint. */
+function checkpointDue(ctx: ScanContext): boolean {
+  return ctx.counter.count - ctx.counter.lastYield >= YIELD_INTERVAL
+    || performance.now() - ctx.counter.lastYieldAt >= YIELD_MS
+}
+
+/** Flush pending rows, send progress and periodically persist the DB. */
+function checkpoint(ctx: ScanContext, currentPath: string) {
+  const { counter } = ctx
+  counter.lastYield = counter.count
+  counter.lastYieldAt = performance.now()
+  // Hand accumulated rows to the write queue, which commits them in bulk
+  flushBatch(ctx)
+  ctx.onProgress?.({
+    runId: ctx.runId,
+    itemsScanned: counter.count,
+    bytesSeen: counter.bytes,
+    ...ctx.estimate.update(counter.covered, counter.bytes),
+    currentPath,
+    state: 'running'
+  })
+  // Checkpoint now and then so a crash mid-scan loses little; the sql.js
+  // image export is the costly part, hence the wide interval
+  if (counter.count - counter.lastPersist >= PERSIST_INTERVAL) {
+    counter.lastPersist = counter.count
+    persistDatabase(ctx.db, ctx.dbPath)
+    // Force garbage collection of large buffers if available
+    if (global.gc) global.gc(false)
+  }
+}
+
+/* ============================================================
+   Sequential walker — async with periodic yielding
+   ============================================================ */
+
+/**
+ * Read a directory entry by entry, yielding on the usual checkpoints, so a
+ * cancel does not wait for a huge listing to finish. Returns null when the
+ * directory cannot be opened; a listing error part-way keeps what was read
+ * and clears `whole`.
+ */
+async function listDir(ctx: ScanContext, dirPath: string): Promise<{ entries: FsEntry[]; whole: boolean } | null> {
+  let dir: FsDir
+  try {
+    dir = ctx.fs.opendirSync(dirPath)
+  } catch {
+    return null
+  }
+  const entries: FsEntry[] = []
+  let whole = true
+  try {
+    for (let e = dir.readSync(); e && !ctx.isCancelled(); e = dir.readSync()) {
+      entries.push(e)
+      if (checkpointDue(ctx)) {
+        checkpoint(ctx, dirPath)
+        await yieldToEventLoop()
+      }
+    }
+  } catch {
+    whole = false
+  } finally {
+    dir.closeSync()
+  }
+  return { entries, whole }
+}
+
+/**
+ * Async full recursive scan. Yields control to the event loop every
+ * YIELD_INTERVAL items so IPC / rendering stays responsive. Returns null
+ * when `dirPath` cannot be listed.
+ */
+async function scanFullAsync(ctx: ScanContext, dirPath: string, depth: number): Promise<AggResult | null> {
+  if (ctx.isCancelled()) {
+    return emptyAgg()
+  }
+
+  const resolved = path.resolve(dirPath)
+  const listing = await listDir(ctx, resolved)
+  if (!listing) return null
+  const { entries } = listing
+  // Cleared when part of the listing, or a child's, could not be read
+  let whole = listing.whole
+
+  const agg = emptyAgg()
+  const heap = ctx.heaps.acquire()
 
   for (const e of entries) {
-    if (isCancelled?.()) {
+    if (ctx.isCancelled()) {
       // Persist what we have so far before bailing out — but do NOT mark
-      // this folder as fully scanned (scannedUtc='') since it was cancelled.
-      if (batchItems.length > 0) {
-        batchItems.push({
-          path: resolved,
-          parent: fsParent(resolved),
-          type: 'Folder',
-          sizeBytes: totalSize,
-          fileCount: totalFiles,
-          folderCount: totalFolders,
-          lastWriteUtc: new Date(latest || Date.now()).toISOString(),
-          scannedUtc: '',
-          depth,
-          runId
-        })
-        upsertItems(db, dbPath, batchItems)
+      // this folder as fully scanned (scannedMs = 0) since it was cancelled.
+      keepFiles(ctx, heap, resolved, depth)
+      if (agg.fileCount + agg.folderCount > 0) {
+        pushFolder(ctx, resolved, depth, agg, false, null)
+        flushBatch(ctx)
       }
-      return { sizeBytes: totalSize, fileCount: totalFiles, folderCount: totalFolders, latestMs: latest }
+      return agg
     }
 
-    const childPath = path.join(resolved, e.name)
+    const childPath = childOf(resolved, e.name)
     if (e.isFile()) {
       try {
-        const s = fs.statSync(childPath)
-        totalSize += s.size
-        totalFiles++
-        latest = Math.max(latest, s.mtimeMs)
-        counter.count++
-        // Only store files large enough to matter individually
-        if (s.size >= MIN_FILE_SIZE_FOR_DB) {
-          batchItems.push({
-            path: childPath,
-            parent: resolved,
-            type: 'File',
-            sizeBytes: s.size,
-            fileCount: 1,
-            folderCount: 0,
-            lastWriteUtc: new Date(s.mtimeMs).toISOString(),
-            scannedUtc: new Date().toISOString(),
-            depth: depth + 1,
-            runId
-          })
-        }
+        const s = ctx.fs.statSync(childPath)
+        agg.sizeBytes += s.size
+        agg.fileCount++
+        agg.latestMs = Math.max(agg.latestMs, s.mtimeMs)
+        countFile(ctx, s.size)
+        offerFile(ctx, heap, e.name, s)
       } catch {
         continue
       }
     } else if (e.isDirectory()) {
-      // Skip re-scanning directories already scanned after the cutoff
-      if (skipScannedAfter) {
-        const existing = getItemByPath(db, childPath)
-        if (existing && existing.scannedUtc && existing.scannedUtc >= skipScannedAfter) {
-          // Use cached values instead of recursing
-          totalSize += existing.sizeBytes
-          totalFiles += existing.fileCount
-          totalFolders += existing.folderCount + 1
-          latest = Math.max(latest, new Date(existing.lastWriteUtc).getTime())
+      // Skip re-scanning directories already scanned after the cutoff,
+      // or moved here from a path we already scanned
+      if (ctx.skipScannedAfter) {
+        const existing = existingRow(ctx, childPath, depth + 1)
+        const reused = existing ? cachedDirAgg(ctx, existing) : await adoptMovedDir(ctx, childPath, depth + 1)
+        if (reused) {
+          keepReused(ctx, childPath, depth + 1, reused)
+          addChildAgg(agg, reused)
+          countReused(ctx, reused)
           continue
         }
       }
 
-      // Flush batch BEFORE recursing to keep stack-frame memory low
-      if (batchItems.length > 0) {
-        upsertItems(db, dbPath, batchItems, false)
-        batchItems.length = 0
-      }
-
-      // Recurse
-      const sub = await scanFullAsync(childPath, depth + 1, runId, db, dbPath, counter, onProgress, isCancelled, skipScannedAfter)
-      totalSize += sub.sizeBytes
-      totalFiles += sub.fileCount
-      totalFolders += sub.folderCount + 1
-      latest = Math.max(latest, sub.latestMs)
+      // Recurse. An unreadable child keeps its rows from earlier scans,
+      // so this folder must not sweep them or claim to be complete.
+      const sub = await scanFullAsync(ctx, childPath, depth + 1)
+      if (!sub) whole = false
+      addChildAgg(agg, sub ?? emptyAgg())
     }
 
     // Periodically yield to the event loop, flush batch, and send progress
-    if (counter.count - counter.lastYield >= YIELD_INTERVAL) {
-      counter.lastYield = counter.count
-      // Flush accumulated items to free memory
-      if (batchItems.length > 0) {
-        upsertItems(db, dbPath, batchItems, false)
-        batchItems.length = 0
-      }
-      onProgress?.({
-        runId,
-        itemsScanned: counter.count,
-        currentPath: resolved,
-        state: 'running'
-      })
-      // Periodically persist DB to disk to free sql.js internal write buffers
-      // Less frequent persistence (50k items) reduces memory spikes from Uint8Array allocations
-      if (counter.count % PERSIST_INTERVAL < YIELD_INTERVAL) {
-        persistDatabase(db, dbPath)
-        // Force garbage collection of large buffers if available
-        if (global.gc) global.gc(false)
-      }
+    if (checkpointDue(ctx)) {
+      checkpoint(ctx, resolved)
       await yieldToEventLoop()
     }
   }
 
   // Record this directory — only mark as scanned if not cancelled
-  const wasCancelled = isCancelled?.() ?? false
+  let id: FsIdStat | null = null
   try {
-    const ds = fs.statSync(resolved)
-    latest = Math.max(latest, ds.mtimeMs)
+    id = ctx.fs.statBigSync(resolved)
+    agg.latestMs = Math.max(agg.latestMs, Number(id.mtimeMs))
   } catch {
     /* ignore */
   }
-  batchItems.push({
-    path: resolved,
-    parent: fsParent(resolved),
-    type: 'Folder',
-    sizeBytes: totalSize,
-    fileCount: totalFiles,
-    folderCount: totalFolders,
-    lastWriteUtc: new Date(latest || Date.now()).toISOString(),
-    scannedUtc: wasCancelled ? '' : new Date().toISOString(),
-    depth,
-    runId
-  })
-  counter.count++
+  keepFiles(ctx, heap, resolved, depth)
+  const complete = !ctx.isCancelled() && whole
+  pushFolder(ctx, resolved, depth, agg, complete, id, complete)
+  ctx.counter.count++
+  ctx.counter.covered++
+
+  return agg
+}
+
+/* ============================================================
+   Pipelined walker — for high-latency (network) mounts
+   ============================================================ */
+
+/**
+ * Metadata requests kept in flight by the pipelined walker. Requests beyond
+ * the libuv threadpool size (see main.ts) queue inside libuv, which still
+ * hides the server round trip behind the ones already running.
+ */
+const PIPELINE_DEPTH = 256
 
-  // Persist this batch (defer disk write — pass false)
-  upsertItems(db, dbPath, batchItems, false)
+/**
+ * Request slots shared by every pipelined walker of one scan, so several
+ * roots together still keep PIPELINE_DEPTH requests in flight. A walker
+ * that finds the pool full queues its pump; each freed slot wakes the
+ * longest-waiting walker, which shares slots round-robin between roots.
+ */
+class RequestPool {
+  private inFlight = 0
+  private waiters: (() => void)[] = []
+
+  constructor(readonly size: number) {}
+
+  tryAcquire(): boolean {
+    if (this.inFlight >= this.size) return false
+    this.inFlight++
+    return true
+  }
 
-  return { sizeBytes: totalSize, fileCount: totalFiles, folderCount: totalFolders, latestMs: latest }
+  release() {
+    this.inFlight--
+    // A woken walker that has run out of work leaves the slot to the next
+    while (this.inFlight < this.size && this.waiters.length > 0) this.waiters.shift()!()
+  }
+
+  /** Call `pump` once a slot frees up. */
+  wait(pump: () => void) {
+    if (!this.waiters.includes(pump)) this.waiters.push(pump)
+  }
+}
+
+/** Calls timed by the latency probe before choosing a walker. */
+const PROBE_SAMPLES = 8
+
+/** Median metadata latency (ms) from which the pipelined walker is used. */
+const HIGH_LATENCY_MS = 1
+
+/** A directory in the pipelined walk. */
+interface DirTask {
+  path: string
+  depth: number
+  parent: DirTask | null
+  /** Outstanding work: the listing itself, each file stat and each child dir. */
+  pending: number
+  /** Set once the directory was listed; unlisted dirs never write a row. */
+  listed: boolean
+  /** Cleared when a child directory could not be listed. */
+  whole: boolean
+  /** No row exists at this path yet — check for a moved directory first. */
+  unknown: boolean
+  id: FsIdStat | null
+  /** Largest files so far; taken from the pool once the listing has files. */
+  heap: FileHeap | null
+  /** File names still waiting to be stat'ed, consumed from `next`. */
+  files: string[]
+  next: number
+  agg: AggResult
+}
+
+/**
+ * Median round trip (ms) of the first few metadata calls under `rootPath`.
+ * Local disks answer in microseconds; network mounts in milliseconds.
+ */
+async function probeLatency(ctx: ScanContext, rootPath: string): Promise<number> {
+  const samples: number[] = []
+  const time = async <T>(op: () => Promise<T>): Promise<T | null> => {
+    const t0 = performance.now()
+    try {
+      return await op()
+    } catch {
+      return null
+    } finally {
+      samples.push(performance.now() - t0)
+    }
+  }
+  await time(() => ctx.fs.stat(rootPath, ctx.signal))
+  const entries = (await time(() => ctx.fs.readdir(rootPath, ctx.signal))) ?? []
+  for (const e of entries.slice(0, PROBE_SAMPLES - 2)) {
+    await time(() => ctx.fs.stat(path.join(rootPath, e.name), ctx.signal))
+  }
+  samples.sort((a, b) => a - b)
+  return samples[samples.length >> 1]
+}
+
+/**
+ * Full scan that keeps readdir/stat requests in flight across many
+ * directories at once, up to what the scan's RequestPool allows.
+ * Directories complete bottom-up as their last pending request settles,
+ * so totals and rows match the sequential walker.
+ */
+function scanPipelined(ctx: ScanContext, rootPath: string, depth: number): Promise<AggResult> {
+  return new Promise((resolve, reject) => {
+    /** Discovered but not yet listed (LIFO keeps the frontier depth-first). */
+    const waiting: DirTask[] = []
+    /** Listed, with file stats still to issue (FIFO finishes dirs in order). */
+    const statting: DirTask[] = []
+    /** Set once writing rows failed: nothing more is issued and the walk rejects. */
+    let failed = false
+    const fail = (err: unknown) => {
+      if (failed) return
+      failed = true
+      statting.length = 0
+      waiting.length = 0
+      reject(err)
+    }
+
+    const newTask = (p: string, d: number, parent: DirTask | null, unknown = false): DirTask => ({
+      path: p, depth: d, parent, pending: 1, listed: false, whole: true, unknown, id: null, heap: null, files: [], next: 0, agg: emptyAgg()
+    })
+
+    const finish = (t: DirTask) => {
+      if (t.heap) {
+        keepFiles(ctx, t.heap, t.path, t.depth)
+        t.heap = null
+      }
+      if (t.listed) {
+        // A child that could not be listed keeps its old rows; no sweep
+        const complete = !ctx.isCancelled() && t.whole
+        pushFolder(ctx, t.path, t.depth, t.agg, complete, t.id, complete)
+        ctx.counter.count++
+        ctx.counter.covered++
+      }
+      if (t.parent) {
+        addChildAgg(t.parent.agg, t.agg)
+        release(t.parent)
+        return
+      }
+      flushBatch(ctx)
+      resolve(t.agg)
+    }
+
+    const release = (t: DirTask) => {
+      if (--t.pending === 0) finish(t)
+    }
+
+    const settle = (t: DirTask) => {
+      try {
+        release(t)
+        if (checkpointDue(ctx)) checkpoint(ctx, t.path)
+      } catch (err) {
+        fail(err)
+      }
+      ctx.pool.release()
+      pump()
+    }
+
+    const list = (t: DirTask) => {
+      Promise.all([ctx.fs.readdir(t.path, ctx.signal), ctx.fs.statBig(t.path, ctx.signal).catch(() => null)])
+        .then(([entries, ds]) => {
+          t.listed = true
+          t.id = ds
+          if (ds) t.agg.latestMs = Math.max(t.agg.latestMs, Number(ds.mtimeMs))
+          for (const e of entries) {
+            if (e.isFile()) {
+              t.files.push(e.name)
+              t.pending++
+            } else if (e.isDirectory()) {
+              const childPath = childOf(t.path, e.name)
+              // Skip re-scanning directories already scanned after the cutoff
+              const existing = ctx.skipScannedAfter ? existingRow(ctx, childPath, t.depth + 1) : null
+              const cached = cachedDirAgg(ctx, existing)
+              if (cached) {
+                keepReused(ctx, childPath, t.depth + 1, cached)
+                addChildAgg(t.agg, cached)
+                countReused(ctx, cached)
+                continue
+              }
+              t.pending++
+              waiting.push(newTask(childPath, t.depth + 1, t, !!ctx.skipScannedAfter && !existing))
+            }
+          }
+          if (t.files.length > 0) {
+            t.heap = ctx.heaps.acquire()
+            statting.push(t)
+          }
+        }, () => {
+          // Inaccessible: leave its rows alone and the parent incomplete
+          if (t.parent) t.parent.whole = false
+        })
+        .finally(() => settle(t))
+        .catch(fail)
+    }
+
+    /** Reuse a moved directory's cached subtree, otherwise list it. */
+    const visit = (t: DirTask) => {
+      if (!t.unknown) {
+        list(t)
+        return
+      }
+      adoptMovedDir(ctx, t.path, t.depth).then((reused) => {
+        if (!reused) {
+          list(t)
+          return
+        }
+        keepReused(ctx, t.path, t.depth, reused)
+        t.agg = reused
+        countReused(ctx, reused)
+        settle(t)
+      }, () => list(t)).catch(fail)
+    }
+
+    const statFile = (t: DirTask, name: string) => {
+      const childPath = childOf(t.path, name)
+      ctx.fs.stat(childPath, ctx.signal)
+        .then((s) => {
+          t.agg.sizeBytes += s.size
+          t.agg.fileCount++
+          t.agg.latestMs = Math.max(t.agg.latestMs, s.mtimeMs)
+          countFile(ctx, s.size)
+          offerFile(ctx, t.heap!, name, s)
+        }, () => { /* skip inaccessible */ })
+        .finally(() => settle(t))
+    }
+
+    /** Drop queued work on cancel; in-flight requests reject via the signal. */
+    const abandon = () => {
+      for (const t of statting.splice(0)) {
+        const left = t.files.length - t.next
+        t.next = t.files.length
+        for (let i = 0; i < left; i++) release(t)
+      }
+      for (const t of waiting.splice(0)) release(t)
+    }
+
+    const pump = () => {
+      if (failed) return
+      try {
+        if (ctx.isCancelled()) {
+          abandon()
+          return
+        }
+        while (statting.length > 0 || waiting.length > 0) {
+          if (!ctx.pool.tryAcquire()) {
+            ctx.pool.wait(pump)
+            return
+          }
+          const t = statting[0]
+          if (t) {
+            const name = t.files[t.next++]
+            if (t.next >= t.files.length) {
+              statting.shift()
+              t.files = []
+              t.next = 0
+            }
+            statFile(t, name)
+            continue
+          }
+          visit(waiting.pop()!)
+        }
+      } catch (err) {
+        fail(err)
+      }
+    }
+
+    waiting.push(newTask(path.resolve(rootPath), depth, null))
+    pump()
+  })
+}
+
+/**
+ * Group root indexes by device. Roots on one device share its disk heads or
+ * server connection, so they are walked one after another; separate devices
+ * run side by side. Roots that cannot be stat'ed get a lane of their own.
+ */
+async function deviceLanes(scanFs: FsProvider, roots: string[]): Promise<number[][]> {
+  const ids = await Promise.all(roots.map((r) => scanFs.statBig(r).then((s) => String(s.dev), () => r)))
+  const lanes = new Map<string, number[]>()
+  ids.forEach((id, i) => {
+    const lane = lanes.get(id)
+    if (lane) lane.push(i)
+    else lanes.set(id, [i])
+  })
+  return [...lanes.values()]
 }
 
 /* ============================================================
@@ -360,10 +904,11 @@ async function scanFullAsync(
    ============================================================ */
 
 /** Synchronous scan (shallow only). Returns runId. */
-export function runScan({ startPath, db, dbPath }: Omit<ScanOptions, 'mode'>): string {
+export function runScan({ startPath, db, dbPath, fs: fsp = activeFsProvider() }: Omit<ScanOptions, 'mode'>): string {
   const runId = randomUUID()
-  const items = scanShallow(startPath, runId)
+  const items = scanShallow(fsp, startPath, runId)
   if (items.length > 0) {
+    registerRoot(db, path.resolve(startPath))
     upsertItems(db, dbPath, items)
   }
   return runId
@@ -372,23 +917,36 @@ export function runScan({ startPath, db, dbPath }: Omit<ScanOptions, 'mode'>): s
 /** Active scans that can be cancelled. */
 export const activeScans = new Map<string, { cancel: () => void }>()
 
-/** Async scan (full recursive). Returns runId. Yields to event loop periodically. */
+/**
+ * Async scan (full recursive). Returns runId. Yields to event loop
+ * periodically. Resolves only once the scan's databases are saved, also
+ * after a cancel, so the caller may release them then.
+ */
 export async function runScanAsync({
   startPath,
   mode,
   db,
   dbPath,
+  shard,
   onProgress,
   isCancelled: externalCancel,
+  signal: externalSignal,
   runId: providedRunId,
-  skipScannedAfter
+  startPaths,
+  fs: fsOverride,
+  skipScannedAfter,
+  elsewhere,
+  latencyMode = 'auto',
+  fileRowBudget = FILE_ROW_BUDGET
 }: AsyncScanOptions): Promise<string> {
   const runId = providedRunId ?? randomUUID()
 
   if (mode === 'shallow') {
-    const items = scanShallow(startPath, runId)
+    const items = scanShallow(fsOverride ?? activeFsProvider(), startPath, runId)
     if (items.length > 0) {
-      upsertItems(db, dbPath, items)
+      const target = shard?.(path.resolve(startPath)) ?? { db, dbPath }
+      registerRoot(target.db, path.resolve(startPath))
+      upsertItems(target.db, target.dbPath, items)
     }
     onProgress?.({
       runId,
@@ -400,11 +958,80 @@ export async function runScanAsync({
   }
 
   // Full async scan with cancellation support
-  let cancelled = false
-  activeScans.set(runId, { cancel: () => { cancelled = true } })
-  const isCancelled = () => cancelled || (externalCancel?.() ?? false)
+  const controller = new AbortController()
+  const cancel = () => controller.abort()
+  activeScans.set(runId, { cancel })
+  externalSignal?.addEventListener('abort', cancel, { once: true })
+  if (externalSignal?.aborted) cancel()
+  const isCancelled = () => {
+    if (!controller.signal.aborted && externalCancel?.()) cancel()
+    return controller.signal.aborted
+  }
+
+  const roots = [...new Set((startPaths?.length ? startPaths : [startPath]).map((p) => path.resolve(p)))]
+  /** Writing rows failed: the scan reports an error and records no history. */
+  let failed = false
+  const scanFs = fsOverride ?? activeFsProvider()
+  const targets = roots.map((root) => shard?.(root) ?? { db, dbPath })
+  roots.forEach((root, i) => registerRoot(targets[i].db, root))
+  // One row budget and request pool for the whole scan; a batch per database
+  const batches = new Map<any, { dbPath: string; batch: ItemBatch }>()
+  for (const t of targets) if (!batches.has(t.db)) batches.set(t.db, { dbPath: t.dbPath, batch: new ItemBatch() })
+  const heaps = new FileHeapPool(FILES_PER_FOLDER)
+  const threshold = new SizeThreshold(fileRowBudget)
+  const pool = new RequestPool(PIPELINE_DEPTH)
+
+  const status: RootProgress[] = roots.map((p) => ({ path: p, state: 'queued', itemsScanned: 0 }))
+  const etas: (number | undefined)[] = roots.map(() => undefined)
+  const totals = () => {
+    let itemsScanned = 0
+    let bytesSeen = 0
+    for (const r of status) {
+      itemsScanned += r.itemsScanned
+      bytesSeen += r.bytesSeen ?? 0
+    }
+    return { itemsScanned, bytesSeen }
+  }
+  /** Fold one root's progress into the scan-wide report. */
+  const report = (i: number, info: ScanProgress) => {
+    const r = status[i]
+    r.itemsScanned = info.itemsScanned
+    r.bytesSeen = info.bytesSeen
+    r.percent = info.percent
+    etas[i] = info.etaSeconds
+    if (roots.length === 1) {
+      onProgress?.(info)
+      return
+    }
+    // Overall percent only when every root can estimate; the ETA is the slowest root's
+    const known = status.every((x) => x.percent !== undefined)
+    const left = etas.filter((e, j): e is number => e !== undefined && status[j].state !== 'completed')
+    onProgress?.({
+      ...info,
+      ...totals(),
+      percent: known ? Math.round(status.reduce((n, x) => n + x.percent!, 0) / status.length * 10) / 10 : undefined,
+      etaSeconds: left.length > 0 ? Math.max(...left) : undefined,
+      roots: status
+    })
+  }
 
-  const counter = { count: 0, lastYield: 0 }
+  const contexts = roots.map((root, i): ScanContext => ({
+    runId,
+    db: targets[i].db,
+    dbPath: targets[i].dbPath,
+    fs: scanFs,
+    counter: { count: 0, lastYield: 0, lastYieldAt: performance.now(), lastPersist: 0, covered: 0, bytes: 0 },
+    estimate: new ScanEstimator(expectedTotals(targets[i].db, root)),
+    onProgress: (info) => report(i, info),
+    signal: controller.signal,
+    isCancelled,
+    skipScannedAfter,
+    elsewhere,
+    pool,
+    batch: batches.get(targets[i].db)!.batch,
+    heaps,
+    threshold
+  }))
   onProgress?.({
     runId,
     itemsScanned: 0,
@@ -413,36 +1040,103 @@ export async function runScanAsync({
   })
 
   try {
-    await scanFullAsync(startPath, 0, runId, db, dbPath, counter, onProgress, isCancelled, skipScannedAfter)
+    const lanes = await deviceLanes(scanFs, roots)
+    // Devices proceed side by side, each walking one root at a time
+    await Promise.all(lanes.map(async (lane) => {
+      for (const i of lane) {
+        if (isCancelled()) break
+        const ctx = contexts[i]
+        status[i].state = 'running'
+        const pipelined = latencyMode === 'high'
+          || (latencyMode === 'auto' && (await probeLatency(ctx, roots[i])) >= HIGH_LATENCY_MS)
+        if (pipelined) {
+          await scanPipelined(ctx, roots[i], 0)
+        } else {
+          await scanFullAsync(ctx, roots[i], 0)
+          flushBatch(ctx)
+        }
+        status[i].state = isCancelled() ? 'cancelled' : 'completed'
+        if (!isCancelled()) {
+          status[i].percent = 100
+          status[i].itemsScanned = ctx.counter.count
+          status[i].bytesSeen = ctx.counter.bytes
+        }
+      }
+    }))
+    // Commit what is still queued, so a failed write fails the scan
+    if (!isCancelled()) for (const d of batches.keys()) flushWrites(d)
 
+    const { itemsScanned, bytesSeen } = totals()
+    const perRoot = roots.length > 1 ? status : undefined
     if (isCancelled()) {
+      for (const r of status) if (r.state !== 'completed') r.state = 'cancelled'
       onProgress?.({
         runId,
-        itemsScanned: counter.count,
+        itemsScanned,
         currentPath: startPath,
         state: 'cancelled',
-        message: `Scan cancelled after ${counter.count} items`
+        message: `Scan cancelled after ${itemsScanned} items`,
+        roots: perRoot
       })
     } else {
       onProgress?.({
         runId,
-        itemsScanned: counter.count,
+        itemsScanned,
+        bytesSeen,
+        percent: 100,
+        etaSeconds: 0,
         currentPath: startPath,
-        state: 'completed'
+        state: 'completed',
+        roots: perRoot
       })
     }
   } catch (err: any) {
+    failed = true
+    // Stop the walks of the other roots as well
+    cancel()
     onProgress?.({
       runId,
-      itemsScanned: counter.count,
+      itemsScanned: totals().itemsScanned,
       currentPath: startPath,
       state: 'error',
       message: err?.message ?? String(err)
     })
   } finally {
     activeScans.delete(runId)
-    // Persist DB to disk once at end of scan
-    persistDatabase(db, dbPath)
+    externalSignal?.removeEventListener('abort', cancel)
+    const finalize = () => {
+      // Drop rows admitted before the size threshold last went up
+      if (threshold.minBytes > 0) {
+        for (const d of batches.keys()) {
+          try {
+            pruneSmallFiles(d, runId, threshold.minBytes)
+          } catch (err: any) {
+            console.error(`Pruning small files of ${batches.get(d)!.dbPath} failed: ${err?.message ?? err}`)
+          }
+        }
+      }
+      // Only roots walked to the end have totals worth keeping in the history
+      for (let i = 0; i < roots.length; i++) {
+        if (failed || status[i].state !== 'completed') continue
+        try {
+          recordSnapshot(targets[i].db, roots[i], runId)
+        } catch (err: any) {
+          console.error(`Recording a snapshot of ${roots[i]} failed: ${err?.message ?? err}`)
+        }
+      }
+      // Persist each DB to disk once at end of scan
+      for (const [d, { dbPath: p }] of batches) {
+        try {
+          persistDatabase(d, p)
+        } catch (err: any) {
+          console.error(`Saving ${p} failed: ${err?.message ?? err}`)
+        }
+      }
+    }
+    // A cancelled scan has already reported; keep the export off that path.
+    // Still finish before returning, so the caller can release the shards.
+    if (isCancelled()) await yieldToEventLoop()
+    finalize()
   }
 
   return runId
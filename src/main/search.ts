@@ -0,0 +1,154 @@
+import { ItemRecord, SearchRequest, SearchStatus } from '../shared/types'
+import { searchIndexed, searchLargest, searchNames, withPaths } from './db'
+import { ShardSet } from './shards'
+
+/* ============================================================
+   Name search — every shard, best matches streamed as found
+   ============================================================ */
+
+/** Largest rows per shard checked before anything else. */
+const HEAD_ROWS = 2_000
+/** Largest rows checked next where the first ones had matches, but too few. */
+const WIDE_HEAD_ROWS = 20_000
+/** Most names a trigram lookup may go through; more are scanned for in steps. */
+const INDEX_CAP = 20_000
+/** Rows per searchNames() step; the event loop runs between steps. */
+const STEP_ROWS = 2_000
+const SEND_INTERVAL_MS = 200
+const DEFAULT_LIMIT = 500
+
+/** Active searches that can be cancelled. */
+export const activeSearches = new Map<string, { cancel: () => void }>()
+
+/**
+ * A query as a SQL LIKE pattern plus the exact test it stands in for. With
+ * `*` or `?` the query is a whole-name pattern; otherwise any name
+ * containing it matches. Both ignore case. The LIKE pattern may match more
+ * than the test: a `%` or `_` in the query is a wildcard to SQL, and no
+ * ESCAPE clause can be given without losing the trigram index.
+ */
+export function compileQuery(query: string): { like: string; test: RegExp } | null {
+  const q = query.trim()
+  if (!q) return null
+  const pattern = /[*?]/.test(q)
+  const source = [...q]
+    .map((c) => (c === '*' ? '.*' : c === '?' ? '.' : c.replace(/[.+^${}()|[\]\\]/g, '\\$&')))
+    .join('')
+  return {
+    like: pattern ? q.replace(/\*/g, '%').replace(/\?/g, '_') : `%${q}%`,
+    test: new RegExp(pattern ? `^${source}$` : source, 'i')
+  }
+}
+
+/** The `limit` largest matches so far; keyed by path, so a row found twice counts once. */
+class BestMatches {
+  private byPath = new Map<string, ItemRecord>()
+  /** Size a match needs to make the list; rises as it fills. */
+  floor = 0
+  changed = false
+
+  constructor(private readonly limit: number) {}
+
+  add(items: ItemRecord[]) {
+    for (const it of items) {
+      if (it.sizeBytes < this.floor || this.byPath.has(it.path)) continue
+      this.byPath.set(it.path, it)
+      this.changed = true
+    }
+    if (this.byPath.size > 2 * this.limit) this.trim()
+  }
+
+  list(): ItemRecord[] {
+    this.trim()
+    return [...this.byPath.values()]
+  }
+
+  private trim() {
+    const sorted = [...this.byPath.values()].sort((a, b) => b.sizeBytes - a.sizeBytes)
+    if (sorted.length > this.limit) {
+      sorted.length = this.limit
+      this.floor = sorted[this.limit - 1].sizeBytes
+    }
+    this.byPath = new Map(sorted.map((it) => [it.path, it]))
+  }
+}
+
+/**
+ * Search item names in every shard, reporting the largest matches through
+ * `onStatus`. The largest rows of each shard are checked first: that
+ * answers at once, and when it fills the list the shard is done, as
+ * nothing smaller can displace them. Otherwise the rest comes from the
+ * trigram index for rare names, or from a scan in steps for names too
+ * common for it, with updates sent at most every SEND_INTERVAL_MS.
+ */
+export async function runSearch(
+  shards: ShardSet,
+  searchId: string,
+  req: SearchRequest,
+  onStatus: (status: SearchStatus) => void
+) {
+  const limit = req.limit ?? DEFAULT_LIMIT
+  const best = new BestMatches(limit)
+  let cancelled = false
+  activeSearches.set(searchId, { cancel: () => { cancelled = true } })
+  let lastSent = 0
+  let shown = 0
+  const send = (state: SearchStatus['state'], message?: string) => {
+    const items = best.list()
+    lastSent = Date.now()
+    shown = items.length
+    best.changed = false
+    onStatus({ searchId, state, message, items })
+  }
+  /** Send news while running — straight away when the last update had no rows. */
+  const update = () => {
+    if (best.changed && (shown === 0 || Date.now() - lastSent >= SEND_INTERVAL_MS)) send('running')
+  }
+
+  try {
+    const pattern = compileQuery(req.query)
+    if (pattern) {
+      /** Keep the rows the exact test passes; returns how many did. */
+      const accept = (db: any, rows: Record<string, any>[]) => {
+        const hits = rows.filter((r) => pattern.test.test(r.name))
+        best.add(withPaths(db, hits.filter((r) => r.sizeBytes >= best.floor)))
+        return hits.length
+      }
+      // One visit per shard, pinned while its steps yield to the event loop
+      for await (const shard of shards.each()) {
+        if (cancelled) break
+        shards.pin(shard.dbPath, 1)
+        try {
+          const hits = accept(shard.db, searchLargest(shard.db, pattern.like, req, HEAD_ROWS, limit))
+          update()
+          if (hits >= limit) continue
+          // Common names likely fill the list from a few more of the largest rows
+          if (hits > 0 && accept(shard.db, searchLargest(shard.db, pattern.like, req, WIDE_HEAD_ROWS, limit)) >= limit) {
+            update()
+            continue
+          }
+          const found = searchIndexed(shard.db, pattern.like, req, INDEX_CAP, best.floor)
+          if (found) {
+            accept(shard.db, found)
+            update()
+            continue
+          }
+          for (let after: number | null = 0; after !== null && !cancelled;) {
+            const step = searchNames(shard.db, pattern.like, req, after, STEP_ROWS, best.floor)
+            accept(shard.db, step.rows)
+            after = step.next
+            update()
+            await new Promise((resolve) => setImmediate(resolve))
+          }
+        } finally {
+          shards.pin(shard.dbPath, -1)
+        }
+      }
+    }
+    send(cancelled ? 'cancelled' : 'completed')
+  } catch (err: any) {
+    send('error', err?.message ?? String(err))
+  } finally {
+    activeSearches.delete(searchId)
+  }
+}
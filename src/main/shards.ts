@@ -0,0 +1,459 @@
+import { createHash } from 'node:crypto'
+import fs from 'node:fs'
+import path from 'node:path'
+import { ChildResponse, ItemRecord, ItemType } from '../shared/types'
+import { closeDatabase, defaultDbPath, deleteDatabase, getFolderByInode, getRootPaths, getRoots, getTop, openDatabase, resetDatabase } from './db'
+import type { Elsewhere } from './scanner'
+
+/* ============================================================
+   Shards — one database per scan root, listed in a catalog
+   ============================================================ */
+
+/** Largest rows of each type the catalog keeps per shard. */
+const SUMMARY_TOP = 100
+/** Shards open at once; the least recently used idle one is closed past this. */
+const MAX_OPEN_SHARDS = 4
+/** Resident memory past which idle shards are closed (sql.js holds them whole). */
+const SHARD_MEMORY_BYTES = 1536 * 1024 * 1024
+
+/** A saved shard's summary is rewritten at most this often (ms). */
+const SUMMARY_DELAY_MS = 1000
+/** Wait (ms) after launch before shards open in the background. */
+const WARM_DELAY_MS = 1500
+/** Extra wait (ms) before each shard open, from LFB_SHARD_OPEN_DELAY_MS; tests slow loads with it. */
+const OPEN_DELAY_MS = Number(process.env.LFB_SHARD_OPEN_DELAY_MS) || 0
+
+const CATALOG_FILE = 'catalog.json'
+const CATALOG_VERSION = 1
+
+/** What the catalog knows about one shard without opening it. */
+export interface ShardSummary {
+  /** File name inside the data directory. */
+  file: string
+  /** Scan roots whose rows live in this shard. */
+  rootPaths: string[]
+  /** The shard's rows for the root view, as getRoots() returned them. */
+  roots: ItemRecord[]
+  /** Its SUMMARY_TOP largest folders and files. */
+  top: Record<ItemType, ItemRecord[]>
+}
+
+interface Catalog {
+  version: number
+  shards: ShardSummary[]
+}
+
+export interface OpenShard {
+  db: any
+  dbPath: string
+  usedAt: number
+  /** Scans, searches and filters using the shard; a pinned shard is never closed. */
+  pins: number
+}
+
+/** True when `p` is `root` or lies below it. */
+function within(root: string, p: string): boolean {
+  if (p === root) return true
+  return p.startsWith(root.endsWith(path.sep) ? root : root + path.sep)
+}
+
+function bySize(a: ItemRecord, b: ItemRecord) {
+  return b.sizeBytes - a.sizeBytes
+}
+
+function byPath(a: ItemRecord, b: ItemRecord) {
+  return a.path < b.path ? -1 : a.path > b.path ? 1 : 0
+}
+
+function shardBytes(s: ShardSummary): number {
+  return s.roots.reduce((n, r) => n + r.sizeBytes, 0)
+}
+
+/**
+ * Every scan root's rows live in a database of their own, named in
+ * `catalog.json` next to them. The catalog also holds each shard's root
+ * rows and top lists, so the root view and the top lists are answered
+ * without opening a shard; anything else opens the one shard it needs.
+ * A root scanned inside an existing shard's root joins that shard, and a
+ * database from before sharding becomes the first shard as it is.
+ *
+ * The catalog is rewritten shortly after each save of a shard, so a launch
+ * can paint from it at once — no WASM, no database read — while warm()
+ * opens the largest shards in the background.
+ */
+export class ShardSet {
+  private readonly opened = new Map<string, OpenShard>()
+  /** Opens in progress, so concurrent callers share one handle. */
+  private readonly opening = new Map<string, Promise<OpenShard>>()
+  private catalog: Catalog = { version: CATALOG_VERSION, shards: [] }
+  /** Shards saved since their summary was last written. */
+  private readonly saved = new Set<string>()
+  private summaryTimer: ReturnType<typeof setTimeout> | null = null
+
+  private constructor(readonly dir: string) {}
+
+  /**
+   * Read the catalog in `dir`. Without one — or with one that cannot be
+   * read — the catalog is rebuilt from the shard files there, a pre-shard
+   * database included.
+   */
+  static async load(dir = path.dirname(defaultDbPath)): Promise<ShardSet> {
+    const set = new ShardSet(dir)
+    let catalog: Catalog
+    try {
+      catalog = JSON.parse(fs.readFileSync(set.catalogPath, 'utf8')) as Catalog
+      if (catalog.version !== CATALOG_VERSION || !Array.isArray(catalog.shards)) {
+        throw new Error(`unknown catalog version ${catalog.version}`)
+      }
+    } catch (err: any) {
+      if (err?.code !== 'ENOENT') console.error('The shard catalog is unreadable; rebuilding it:', err)
+      await set.rebuild()
+      return set
+    }
+    set.catalog = catalog
+    // Shards a reset emptied and no scan wrote to since
+    const empty = catalog.shards.filter((s) => s.rootPaths.length === 0)
+    if (empty.length > 0) {
+      for (const s of empty) deleteDatabase(path.join(dir, s.file))
+      catalog.shards = catalog.shards.filter((s) => s.rootPaths.length > 0)
+      set.save()
+    }
+    return set
+  }
+
+  /** Catalog every shard file in the directory from its contents. */
+  private async rebuild() {
+    const legacy = path.basename(defaultDbPath)
+    let files: string[] = []
+    try {
+      files = fs.readdirSync(this.dir).filter((f) => f === legacy || /^shard-[0-9a-f]+\.sqlite$/.test(f))
+    } catch {
+      // No data directory yet
+    }
+    for (const file of files) {
+      const shard: ShardSummary = { file, rootPaths: [], roots: [], top: { Folder: [], File: [] } }
+      this.catalog.shards.push(shard)
+      try {
+        const { db } = await this.open(shard)
+        this.summarize(shard, db)
+        shard.rootPaths = getRootPaths(db)
+      } catch (err) {
+        console.error(`Opening shard ${file} failed:`, err)
+        this.catalog.shards.splice(this.catalog.shards.indexOf(shard), 1)
+      }
+    }
+    if (this.catalog.shards.length > 0) this.save()
+  }
+
+  private get catalogPath() {
+    return path.join(this.dir, CATALOG_FILE)
+  }
+
+  /** Write the catalog atomically; it is small. */
+  private save() {
+    fs.mkdirSync(this.dir, { recursive: true })
+    const tmp = `${this.catalogPath}.tmp`
+    fs.writeFileSync(tmp, JSON.stringify(this.catalog))
+    fs.renameSync(tmp, this.catalogPath)
+  }
+
+  /** The shard holding `p`: the one with the deepest root above it. */
+  shardOf(p: string): ShardSummary | null {
+    let best: ShardSummary | null = null
+    let depth = -1
+    for (const s of this.catalog.shards) {
+      for (const r of s.rootPaths) {
+        if (r.length > depth && within(r, p)) {
+          best = s
+          depth = r.length
+        }
+      }
+    }
+    return best
+  }
+
+  /** Every shard in the catalog. */
+  list(): ShardSummary[] {
+    return [...this.catalog.shards]
+  }
+
+  /** Shards that may hold rows at or below `p`: the one holding `p` and those of roots below it. */
+  holding(p: string): ShardSummary[] {
+    const own = this.shardOf(p)
+    return this.catalog.shards.filter((s) => s === own || s.rootPaths.some((r) => within(p, r)))
+  }
+
+  /** Open `shard` (or touch it when open), closing idle ones beyond the limits. */
+  async open(shard: ShardSummary): Promise<OpenShard> {
+    let o = this.opened.get(shard.file)
+    if (!o) {
+      let pending = this.opening.get(shard.file)
+      if (!pending) {
+        const ready = OPEN_DELAY_MS > 0 ? new Promise((resolve) => setTimeout(resolve, OPEN_DELAY_MS)) : Promise.resolve()
+        pending = ready.then(() => openDatabase(path.join(this.dir, shard.file))).then((res) => {
+          const opened: OpenShard = { db: res.db, dbPath: res.dbPath, usedAt: 0, pins: 0 }
+          this.opened.set(shard.file, opened)
+          return opened
+        }).finally(() => this.opening.delete(shard.file))
+        this.opening.set(shard.file, pending)
+      }
+      o = await pending
+    }
+    o.usedAt = performance.now()
+    await this.trim(shard.file)
+    return o
+  }
+
+  /**
+   * Open the shards behind the largest roots, up to MAX_OPEN_SHARDS, one
+   * at a time after WARM_DELAY_MS — by then the first paint has been
+   * served from the catalog, and the first click into a root finds its
+   * shard loaded.
+   */
+  warm() {
+    const timer = setTimeout(async () => {
+      const order = [...this.catalog.shards].sort((a, b) => shardBytes(b) - shardBytes(a))
+      for (const s of order.slice(0, MAX_OPEN_SHARDS)) {
+        if (!this.catalog.shards.includes(s)) continue
+        try {
+          await this.open(s)
+        } catch (err) {
+          console.error(`Opening shard ${s.file} failed:`, err)
+        }
+      }
+    }, WARM_DELAY_MS)
+    timer.unref?.()
+  }
+
+  /** A shard was written to disk: rewrite its summary within SUMMARY_DELAY_MS. */
+  persisted(dbPath: string) {
+    for (const [file, o] of this.opened) if (o.dbPath === dbPath) this.saved.add(file)
+    if (this.saved.size === 0 || this.summaryTimer) return
+    this.summaryTimer = setTimeout(() => {
+      this.summaryTimer = null
+      try {
+        for (const file of this.saved) {
+          const o = this.opened.get(file)
+          const s = this.catalog.shards.find((x) => x.file === file)
+          if (o && s) this.summarize(s, o.db)
+        }
+        this.saved.clear()
+        this.save()
+      } catch (err) {
+        console.error('Saving the shard catalog failed:', err)
+      }
+    }, SUMMARY_DELAY_MS)
+    this.summaryTimer.unref?.()
+  }
+
+  /** The open shard holding `p`, or null when no scan root covers it. */
+  async forPath(p: string): Promise<OpenShard | null> {
+    const s = this.shardOf(p)
+    return s ? this.open(s) : null
+  }
+
+  /** The shard a scan of `root` writes to, created when no root covers it. */
+  async forScan(root: string): Promise<OpenShard> {
+    let s = this.shardOf(root)
+    if (!s) {
+      // A shard a reset emptied is still open under this root's name
+      const hash = createHash('sha1').update(root).digest('hex').slice(0, 16)
+      const file = `shard-${hash}.sqlite`
+      s = this.catalog.shards.find((x) => x.file === file) ?? null
+      if (s) {
+        s.rootPaths.push(root)
+      } else {
+        s = { file, rootPaths: [root], roots: [], top: { Folder: [], File: [] } }
+        this.catalog.shards.push(s)
+      }
+      this.save()
+    } else if (!s.rootPaths.includes(root)) {
+      s.rootPaths.push(root)
+      this.save()
+    }
+    return this.open(s)
+  }
+
+  /**
+   * Open and pin the shards of roots nested below any of `roots` but held
+   * apart from them, so an incremental scan of `roots` can reuse their
+   * rows. Returns their dbPaths, to unpin once the scan is over.
+   */
+  async nestedIn(roots: string[]): Promise<string[]> {
+    const own = new Set(roots.map((r) => this.shardOf(r)))
+    const pinned: string[] = []
+    for (const s of [...this.catalog.shards]) {
+      if (own.has(s) || !s.rootPaths.some((p) => roots.some((r) => within(r, p)))) continue
+      const o = await this.open(s)
+      o.pins++
+      pinned.push(o.dbPath)
+    }
+    return pinned
+  }
+
+  /**
+   * Rows of other shards for a scan writing to one of them: paths under a
+   * nested root are answered by that root's shard when it is open (see
+   * nestedIn), and a moved folder is looked for in every shard, open ones
+   * first and closed ones in turn under the usual limits.
+   */
+  elsewhere(): Elsewhere {
+    return {
+      holder: (p, db) => {
+        const s = this.shardOf(p)
+        const o = s ? this.opened.get(s.file) : undefined
+        return o && o.db !== db ? o : null
+      },
+      byInode: async (dev, ino, db) => {
+        const order = [...this.catalog.shards]
+          .sort((a, b) => Number(this.opened.has(b.file)) - Number(this.opened.has(a.file)))
+        for (const s of order) {
+          if (!this.catalog.shards.includes(s)) continue
+          const o = await this.open(s)
+          if (o.db === db) continue
+          const row = getFolderByInode(o.db, dev, ino)
+          if (!row) continue
+          o.pins++
+          return { row, db: o.db, dbPath: o.dbPath }
+        }
+        return null
+      },
+      release: (dbPath) => this.pin(dbPath, -1)
+    }
+  }
+
+  /** Keep the shard of `dbPath` open while a scan or search uses it. */
+  pin(dbPath: string, by: 1 | -1) {
+    for (const o of this.opened.values()) if (o.dbPath === dbPath) o.pins += by
+  }
+
+  /** Close least recently used idle shards while over MAX_OPEN_SHARDS or SHARD_MEMORY_BYTES. */
+  private async trim(keep: string) {
+    for (;;) {
+      const over = this.opened.size > MAX_OPEN_SHARDS
+        || (this.opened.size > 1 && process.memoryUsage().rss > SHARD_MEMORY_BYTES)
+      if (!over) return
+      let victim: string | null = null
+      for (const [file, o] of this.opened) {
+        if (file === keep || o.pins > 0) continue
+        if (victim === null || o.usedAt < this.opened.get(victim)!.usedAt) victim = file
+      }
+      if (victim === null) return
+      await this.close(victim)
+    }
+  }
+
+  private async close(file: string) {
+    const o = this.opened.get(file)!
+    this.opened.delete(file)
+    const s = this.catalog.shards.find((x) => x.file === file)
+    if (s) {
+      this.summarize(s, o.db)
+      this.save()
+    }
+    await closeDatabase(o.db, o.dbPath)
+  }
+
+  /** Copy the root rows and top lists of an open shard into its summary. */
+  private summarize(s: ShardSummary, db: any) {
+    s.roots = getRoots(db).items
+    s.top = { Folder: getTop(db, 'Folder', SUMMARY_TOP), File: getTop(db, 'File', SUMMARY_TOP) }
+  }
+
+  /**
+   * Update the summary of the shard at `dbPath` after a scan that started
+   * at `since` (epoch ms). Shards whose roots all lie below a root of it
+   * that this scan covered in full are dropped: their rows were written
+   * again here, and so do shards a reset emptied, which cover nothing. A
+   * root the scan did not finish keeps its earlier scannedMs, so it
+   * retires nothing.
+   */
+  async refresh(dbPath: string, since = 0) {
+    const entry = [...this.opened].find(([, o]) => o.dbPath === dbPath)
+    if (!entry) return
+    const s = this.catalog.shards.find((x) => x.file === entry[0])
+    if (!s) return
+    this.summarize(s, entry[1].db)
+    const covered = s.roots.filter((r) => r.scannedMs !== 0 && r.scannedMs >= since).map((r) => r.path)
+    for (const other of [...this.catalog.shards]) {
+      if (other === s || !other.rootPaths.every((p) => covered.some((c) => within(c, p)))) continue
+      const o = this.opened.get(other.file)
+      if (o?.pins) continue
+      if (o) {
+        this.opened.delete(other.file)
+        await closeDatabase(o.db, o.dbPath)
+      }
+      deleteDatabase(path.join(this.dir, other.file))
+      this.catalog.shards.splice(this.catalog.shards.indexOf(other), 1)
+    }
+    this.save()
+  }
+
+  /** Summaries of open shards refreshed and saved — for quitting. */
+  saveOpen() {
+    for (const [file, o] of this.opened) {
+      const s = this.catalog.shards.find((x) => x.file === file)
+      if (s) this.summarize(s, o.db)
+    }
+    if (this.catalog.shards.length > 0) this.save()
+  }
+
+  /**
+   * Root rows of every shard: live from open ones, from the catalog
+   * otherwise. As getRoots() does within a shard, a root below another
+   * listed root is left out — its totals are part of that root's.
+   */
+  roots(limit = 200, sort: 'size_desc' | 'name_asc' = 'size_desc'): ChildResponse {
+    const all: ItemRecord[] = []
+    for (const s of this.catalog.shards) {
+      const o = this.opened.get(s.file)
+      all.push(...(o ? getRoots(o.db).items : s.roots))
+    }
+    const rows = all.filter((r) => !all.some((q) => q.path !== r.path && within(q.path, r.path)))
+    rows.sort(sort === 'name_asc' ? byPath : bySize)
+    return { items: rows.slice(0, limit), total: rows.length }
+  }
+
+  /** Largest rows across shards; a closed shard contributes its SUMMARY_TOP. */
+  top(type: ItemType, limit = 100): ItemRecord[] {
+    const rows: ItemRecord[] = []
+    for (const s of this.catalog.shards) {
+      const o = this.opened.get(s.file)
+      rows.push(...(o ? getTop(o.db, type, limit) : s.top[type]))
+    }
+    return rows.sort(bySize).slice(0, limit)
+  }
+
+  /** Every shard, opened one after another under the usual limits. */
+  async *each(): AsyncGenerator<OpenShard> {
+    for (const s of [...this.catalog.shards]) {
+      // Retired meanwhile by a finished scan
+      if (this.catalog.shards.includes(s)) yield await this.open(s)
+    }
+  }
+
+  /**
+   * Start over with no data. Open shards are emptied in place, since a
+   * running scan may still hold them; closed ones are deleted. The emptied
+   * ones cover no root until a scan writes to them again, and are deleted
+   * at the next launch if none does.
+   */
+  async reset() {
+    const kept: ShardSummary[] = []
+    for (const s of this.catalog.shards) {
+      const o = this.opened.get(s.file)
+      if (!o) {
+        deleteDatabase(path.join(this.dir, s.file))
+        continue
+      }
+      const res = await resetDatabase(o.dbPath, o.db)
+      o.db = res.db
+      s.rootPaths = []
+      s.roots = []
+      s.top = { Folder: [], File: [] }
+      kept.push(s)
+    }
+    this.catalog.shards = kept
+    this.save()
+  }
+}
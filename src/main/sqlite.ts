@@ -0,0 +1,141 @@
+/* ============================================================
+   Native SQLite engine — node:sqlite behind the sql.js API
+   ============================================================ */
+
+/**
+ * The built-in node:sqlite module, or null when this runtime lacks it or
+ * `LFB_SQLITE_ENGINE=sqljs` asks for the in-memory WASM engine instead.
+ */
+export function nativeSqlite(): any | null {
+  if (process.env.LFB_SQLITE_ENGINE === 'sqljs') return null
+  try {
+    return (process as any).getBuiltinModule?.('node:sqlite') ?? null
+  } catch {
+    return null
+  }
+}
+
+/** Statements run() keeps compiled per handle; the least recently used go first. */
+const RUN_CACHE_SIZE = 64
+
+/** `LFB_STMT_CACHE=0` prepares per call again, for comparison. */
+const cacheStatements = process.env.LFB_STMT_CACHE !== '0'
+
+/** sql.js-style parameters → node:sqlite call arguments. */
+function args(params: any): any[] {
+  if (params === undefined || params === null) return []
+  return Array.isArray(params) ? params : [params]
+}
+
+/**
+ * A prepared statement with the sql.js surface the query functions use:
+ * bind / step / getAsObject / run / reset / free. Rows stream from an
+ * iterator; reset or free (or stepping past the end) closes the cursor,
+ * which would otherwise hold back WAL checkpoints.
+ */
+class NativeStatement {
+  private params: any
+  private rows: Iterator<any> | null = null
+  private row: any = null
+
+  constructor(private readonly stmt: any) {}
+
+  bind(params?: any): boolean {
+    this.reset()
+    this.params = params
+    return true
+  }
+
+  step(): boolean {
+    if (!this.rows) {
+      const a = args(this.params)
+      // iterate() arrived in Node 22.13; older runtimes read the result at once
+      this.rows = this.stmt.iterate ? this.stmt.iterate(...a) : this.stmt.all(...a)[Symbol.iterator]()
+    }
+    const next = this.rows!.next()
+    if (next.done) {
+      this.reset()
+      return false
+    }
+    this.row = next.value
+    return true
+  }
+
+  /** The current row. Unlike sql.js it has a null prototype; copy it before handing it out. */
+  getAsObject(): Record<string, any> {
+    return this.row
+  }
+
+  run(params?: any) {
+    this.reset()
+    if (params !== undefined) this.params = params
+    this.stmt.run(...args(this.params))
+  }
+
+  reset(): boolean {
+    this.rows?.return?.()
+    this.rows = null
+    this.row = null
+    return true
+  }
+
+  free(): boolean {
+    return this.reset()
+  }
+}
+
+/**
+ * A database file opened in WAL mode, shaped like a sql.js Database. Each
+ * commit goes straight to the file, so nothing is held in memory and
+ * nothing needs exporting.
+ */
+export class NativeDatabase {
+  readonly native = true
+  private readonly db: any
+  /** run() statements by SQL text, oldest first. */
+  private readonly runCache = new Map<string, any>()
+
+  constructor(dbPath: string, sqlite = nativeSqlite()) {
+    this.db = new sqlite.DatabaseSync(dbPath)
+    this.db.exec('PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL; PRAGMA busy_timeout = 5000')
+  }
+
+  run(sql: string, params?: any) {
+    if (params === undefined) this.db.exec(sql)
+    else this.compiled(sql).run(...args(params))
+    return this
+  }
+
+  /** The statement for `sql` from the run() cache, compiled on a miss. */
+  private compiled(sql: string): any {
+    if (!cacheStatements) return this.db.prepare(sql)
+    let stmt = this.runCache.get(sql)
+    if (stmt) {
+      // Re-insert: Map order doubles as recency
+      this.runCache.delete(sql)
+    } else {
+      stmt = this.db.prepare(sql)
+      if (this.runCache.size >= RUN_CACHE_SIZE) this.runCache.delete(this.runCache.keys().next().value!)
+    }
+    this.runCache.set(sql, stmt)
+    return stmt
+  }
+
+  prepare(sql: string): NativeStatement {
+    return new NativeStatement(this.db.prepare(sql))
+  }
+
+  /** Fold the write-ahead log back into the main file without blocking readers. */
+  checkpoint() {
+    try {
+      this.db.exec('PRAGMA wal_checkpoint(PASSIVE)')
+    } catch {
+      // Busy — SQLite checkpoints on its own as the log grows
+    }
+  }
+
+  close() {
+    this.runCache.clear()
+    this.db.close()
+  }
+}
@@ -1,9 +1,20 @@
 import { contextBridge, ipcRenderer } from 'electron'
-import { ChildRequest, ScanRequest, TopRequest } from '../shared/types'
+import { ChildRequest, FilterRequest, GrowthRequest, ScanFileTopRequest, ScanRequest, SearchRequest, TopRequest } from '../shared/types'
 
 const api = {
   children: (req: ChildRequest) => ipcRenderer.invoke('children', req),
   top: (req: TopRequest) => ipcRenderer.invoke('top', req),
+  snapshots: (rootPath?: string) => ipcRenderer.invoke('snapshots', rootPath),
+  sizeAt: (folderPath: string, snapshotId: number) => ipcRenderer.invoke('size-at', folderPath, snapshotId),
+  growth: (req: GrowthRequest) => ipcRenderer.invoke('growth', req),
+  search: (req: SearchRequest) => ipcRenderer.invoke('search', req),
+  cancelSearch: (searchId: string) => ipcRenderer.invoke('cancel-search', searchId),
+  filter: (req: FilterRequest) => ipcRenderer.invoke('filter', req),
+  cancelFilter: (filterId: string) => ipcRenderer.invoke('cancel-filter', filterId),
+  exportScan: (rootPath: string, file: string) => ipcRenderer.invoke('export-scan', rootPath, file),
+  importScan: (file: string) => ipcRenderer.invoke('import-scan', file),
+  scanFileTop: (file: string, req: ScanFileTopRequest) => ipcRenderer.invoke('scan-file-top', file, req),
+  scanFileChildren: (file: string, req: ChildRequest) => ipcRenderer.invoke('scan-file-children', file, req),
   scan: (req: ScanRequest) => ipcRenderer.invoke('scan', req),
   listDir: (dirPath: string) => ipcRenderer.invoke('list-dir', dirPath),
   listDrives: () => ipcRenderer.invoke('list-drives'),
@@ -16,6 +27,21 @@ const api = {
     ipcRenderer.on('scan-status', handler)
     return () => ipcRenderer.removeListener('scan-status', handler)
   },
+  onSearchStatus: (cb: (status: any) => void) => {
+    const handler = (_event: any, status: any) => cb(status)
+    ipcRenderer.on('search-status', handler)
+    return () => ipcRenderer.removeListener('search-status', handler)
+  },
+  onFilterPage: (cb: (page: any) => void) => {
+    const handler = (_event: any, page: any) => cb(page)
+    ipcRenderer.on('filter-page', handler)
+    return () => ipcRenderer.removeListener('filter-page', handler)
+  },
+  onDbSaved: (cb: (savedUtc: string) => void) => {
+    const handler = (_event: any, savedUtc: string) => cb(savedUtc)
+    ipcRenderer.on('db-saved', handler)
+    return () => ipcRenderer.removeListener('db-saved', handler)
+  },
   onMenuResetDb: (cb: () => void) => {
     const handler = () => cb()
     ipcRenderer.on('menu-reset-db', handler)
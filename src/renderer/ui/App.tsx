@@ -13,6 +13,32 @@ function formatSize(bytes: number): string {
   return `${bytes} B`
 }
 
+type ScanProgressView = Pick<ScanStatus, 'bytesSeen' | 'percent' | 'etaSeconds' | 'roots' | 'currentPath'> & { itemsScanned: number }
+
+function formatEta(seconds: number): string {
+  if (seconds < 60) return `${Math.max(1, Math.round(seconds))} s`
+  if (seconds < 3600) return `${Math.round(seconds / 60)} min`
+  return `${Math.floor(seconds / 3600)} h ${Math.round((seconds % 3600) / 60)} min`
+}
+
+/** "Scanning… 12,345 items · 4.20 GB · 37% · ~2 min left" — parts appear as known. */
+function formatScanProgress(p: ScanProgressView): string {
+  let text = `Scanning\u2026 ${p.itemsScanned.toLocaleString()} items`
+  if (p.bytesSeen) text += ` \u00b7 ${formatSize(p.bytesSeen)}`
+  if (p.percent !== undefined) text += ` \u00b7 ${p.percent.toFixed(0)}%`
+  if (p.etaSeconds !== undefined) text += ` \u00b7 ~${formatEta(p.etaSeconds)} left`
+  return text
+}
+
+/** "C: 40% · D: queued" for multi-root scans. */
+function formatRootsProgress(roots: NonNullable<ScanStatus['roots']>): string {
+  return roots.map((r) => {
+    const name = pathName(r.path)
+    if (r.state !== 'running') return `${name} ${r.state}`
+    return r.percent !== undefined ? `${name} ${r.percent.toFixed(0)}%` : `${name} ${r.itemsScanned.toLocaleString()}`
+  }).join(' \u00b7 ')
+}
+
 function pathName(p: string): string {
   return p.split(/[\\/]/).filter(Boolean).pop() || p
 }
@@ -38,12 +64,6 @@ function buildBreadcrumbs(current: string | null): { label: string; path: string
   return crumbs
 }
 
-function parseIsoMs(iso?: string): number {
-  if (!iso) return 0
-  const ms = Date.parse(iso)
-  return Number.isNaN(ms) ? 0 : ms
-}
-
 /** Merge FS listing with DB data: FS entries give immediate visibility,
  *  DB entries provide scanned sizes. */
 interface DisplayItem {
@@ -53,11 +73,13 @@ interface DisplayItem {
   sizeBytes: number
   fileCount: number
   folderCount: number
-  lastWriteUtc: string
-  scannedUtc: string
   lastWriteMs: number
   scannedMs: number
   hasDbData: boolean
+  /** Browsable like a folder (zip/tar); not itself a directory. */
+  isArchive?: boolean
+  /** Packed size of an entry inside an archive, when known. */
+  compressedBytes?: number
 }
 
 function mergeItems(
@@ -85,11 +107,11 @@ function mergeItems(
         sizeBytes: db ? db.sizeBytes : e.sizeBytes,
         fileCount: db ? db.fileCount : 0,
         folderCount: db ? db.folderCount : 0,
-        lastWriteUtc: db ? db.lastWriteUtc : e.lastWriteUtc,
-        scannedUtc: db ? db.scannedUtc : '',
-        lastWriteMs: parseIsoMs(db ? db.lastWriteUtc : e.lastWriteUtc),
-        scannedMs: parseIsoMs(db ? db.scannedUtc : ''),
-        hasDbData: !!db
+        lastWriteMs: db ? db.lastWriteMs : e.lastWriteMs,
+        scannedMs: db ? db.scannedMs : 0,
+        hasDbData: !!db,
+        isArchive: e.isArchive,
+        compressedBytes: e.compressedBytes
       })
     }
   }
@@ -103,10 +125,8 @@ function mergeItems(
         sizeBytes: r.sizeBytes,
         fileCount: r.fileCount,
         folderCount: r.folderCount,
-        lastWriteUtc: r.lastWriteUtc,
-        scannedUtc: r.scannedUtc,
-        lastWriteMs: parseIsoMs(r.lastWriteUtc),
-        scannedMs: parseIsoMs(r.scannedUtc),
+        lastWriteMs: r.lastWriteMs,
+        scannedMs: r.scannedMs,
         hasDbData: true
       })
     }
@@ -216,7 +236,7 @@ const ListRow = React.memo(({ index, style, data }: ListChildComponentProps<RowD
       data-item-type={item.isDirectory ? 'Folder' : 'File'}
       data-item-name={item.name}
       onClick={() => data.onSelect(item.fullPath)}
-      onDoubleClick={() => item.isDirectory && data.onNavigate(item.fullPath)}
+      onDoubleClick={() => (item.isDirectory || item.isArchive) && data.onNavigate(item.fullPath)}
       onContextMenu={(e) => data.onContextMenu(e, item)}
       style={{
         ...style,
@@ -224,14 +244,14 @@ const ListRow = React.memo(({ index, style, data }: ListChildComponentProps<RowD
         gridTemplateColumns: GRID_TEMPLATE,
         alignItems: 'center',
         height: ROW_HEIGHT,
-        cursor: item.isDirectory ? 'pointer' : 'default',
+        cursor: item.isDirectory || item.isArchive ? 'pointer' : 'default',
         borderBottom: `1px solid ${BORDER}`,
         background: isSel ? SELECTED_BG : undefined
       }}
     >
       <div style={tdStyle}>
         <span style={{ marginRight: 6, fontSize: 14, verticalAlign: 'middle' }}>
-          {item.isDirectory ? '\uD83D\uDCC1' : '\uD83D\uDCC4'}
+          {item.isDirectory ? '\uD83D\uDCC1' : item.isArchive ? '\uD83D\uDDDC' : '\uD83D\uDCC4'}
         </span>
         <span data-testid="item-name" title={item.fullPath} style={{
           fontWeight: item.isDirectory ? 600 : 400,
@@ -240,7 +260,8 @@ const ListRow = React.memo(({ index, style, data }: ListChildComponentProps<RowD
           {data.currentPath === null ? item.fullPath : item.name}
         </span>
       </div>
-      <div style={{ ...tdStyle, textAlign: 'right' }} data-testid="item-size">
+      <div style={{ ...tdStyle, textAlign: 'right' }} data-testid="item-size"
+        title={item.compressedBytes !== undefined ? `${formatSize(item.compressedBytes)} compressed` : undefined}>
         {item.sizeBytes > 0 || item.hasDbData ? formatSize(item.sizeBytes) : '\u2014'}
       </div>
       <div style={{ ...tdStyle, textAlign: 'right', color: '#888' }}>
@@ -270,7 +291,8 @@ export default function App() {
   const [topFiles, setTopFiles] = useState<ItemRecord[]>([])
   const [loading, setLoading] = useState(false)
   const [scanning, setScanning] = useState<string | null>(null)
-  const [scanProgress, setScanProgress] = useState<{ itemsScanned: number; currentPath?: string } | null>(null)
+  const [scanProgress, setScanProgress] = useState<ScanProgressView | null>(null)
+  const [savedUtc, setSavedUtc] = useState<string | null>(null)
   const [error, setError] = useState<string | null>(null)
   const [pathHistory, setPathHistory] = useState<(string | null)[]>([])
   const [selectedPath, setSelectedPath] = useState<string | null>(null)
@@ -441,7 +463,7 @@ export default function App() {
       const result = await window.lfb.scan({
         startPath: folderPath,
         mode: 'full',
-        skipScannedAfter: new Date(cutoffDate).toISOString()
+        skipScannedAfter: new Date(cutoffDate).getTime()
       }) as { runId: string }
       setScanning(result.runId)
     } catch (e: any) {
@@ -472,6 +494,10 @@ export default function App() {
       pendingProgressRef.current = null
       setScanProgress({
         itemsScanned: pending.itemsScanned ?? 0,
+        bytesSeen: pending.bytesSeen,
+        percent: pending.percent,
+        etaSeconds: pending.etaSeconds,
+        roots: pending.roots,
         currentPath: pending.currentPath
       })
     }
@@ -525,6 +551,13 @@ export default function App() {
     }
   }, [scanning])
 
+  /* ---- last durable save ---- */
+
+  useEffect(() => {
+    const unsub = window.lfb.onDbSaved(setSavedUtc)
+    return () => { unsub() }
+  }, [])
+
   /* ---- menu: reset DB ---- */
 
   useEffect(() => {
@@ -567,9 +600,7 @@ export default function App() {
       name: pathName(r.path), fullPath: r.path,
       isDirectory: r.type === 'Folder', sizeBytes: r.sizeBytes,
       fileCount: r.fileCount, folderCount: r.folderCount,
-      lastWriteUtc: r.lastWriteUtc, scannedUtc: r.scannedUtc,
-      lastWriteMs: parseIsoMs(r.lastWriteUtc),
-      scannedMs: parseIsoMs(r.scannedUtc),
+      lastWriteMs: r.lastWriteMs, scannedMs: r.scannedMs,
       hasDbData: true
     }))
     const seenPaths = new Set(dbRoots.map((r) => r.fullPath.toUpperCase()))
@@ -579,7 +610,6 @@ export default function App() {
         name: d.label, fullPath: d.path,
         isDirectory: true, sizeBytes: 0,
         fileCount: 0, folderCount: 0,
-        lastWriteUtc: '', scannedUtc: '',
         lastWriteMs: 0, scannedMs: 0,
         hasDbData: false
       }))
@@ -724,10 +754,18 @@ export default function App() {
                   style={{ ...btnStyle, fontSize: 10, padding: '1px 6px', color: '#c00', borderColor: '#c00' }}
                 >Cancel</button>
                 <span data-testid="scanning-indicator" style={{ color: '#886' }}>
-                  {scanProgress
-                    ? `Scanning\u2026 ${scanProgress.itemsScanned.toLocaleString()} items`
-                    : 'Scanning\u2026'}
+                  {scanProgress ? formatScanProgress(scanProgress) : 'Scanning\u2026'}
                 </span>
+                {scanProgress?.roots && (
+                  <span data-testid="scan-roots" style={{ color: '#886', fontSize: 10 }}>
+                    {formatRootsProgress(scanProgress.roots)}
+                  </span>
+                )}
+                {savedUtc && (
+                  <span data-testid="saved-at" style={{ color: '#888', fontSize: 10 }} title={savedUtc}>
+                    Saved {new Date(savedUtc).toLocaleTimeString()}
+                  </span>
+                )}
                 {scanProgress?.currentPath && (
                   <span style={{ color: '#aaa', overflow: 'hidden', textOverflow: 'ellipsis', whiteSpace: 'nowrap', maxWidth: 300, fontSize: 10 }}>
                     {scanProgress.currentPath}
@@ -871,8 +909,7 @@ export default function App() {
                           setContextMenu({ x: e.clientX, y: e.clientY, item: {
                             name: pathName(f.path), fullPath: f.path, isDirectory: sidebarTab === 'folders',
                             sizeBytes: f.sizeBytes, fileCount: f.fileCount, folderCount: f.folderCount,
-                            lastWriteUtc: f.lastWriteUtc, scannedUtc: f.scannedUtc, hasDbData: true,
-                            lastWriteMs: parseIsoMs(f.lastWriteUtc), scannedMs: parseIsoMs(f.scannedUtc)
+                            lastWriteMs: f.lastWriteMs, scannedMs: f.scannedMs, hasDbData: true
                           }})
                         }}
                       >
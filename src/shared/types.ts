@@ -1,5 +1,8 @@
 export type ItemType = 'File' | 'Folder'
 
+/** Scan tuning for metadata latency: 'auto' probes, 'high' pipelines requests. */
+export type LatencyMode = 'auto' | 'normal' | 'high'
+
 export interface ItemRecord {
   path: string
   parent: string | null
@@ -7,16 +10,26 @@ export interface ItemRecord {
   sizeBytes: number
   fileCount: number
   folderCount: number
-  lastWriteUtc: string
-  scannedUtc: string
+  /** Modification time, epoch ms (the newest in the subtree for folders). */
+  lastWriteMs: number
+  /** When the subtree was last fully scanned, epoch ms; 0 = never. */
+  scannedMs: number
   depth: number
   runId: string
+  /** Folder identity (device + inode, as decimal strings) for move detection. */
+  dev?: string | null
+  ino?: string | null
+  /** The folder's own mtime, used to verify a moved subtree is unchanged. */
+  dirMtimeMs?: number | null
 }
 
 export interface ChildRequest {
   parent: string | null
   limit?: number
+  /** Rows to skip; not together with `cursor`. */
   offset?: number
+  /** `nextCursor` of the previous page; continues right after it. */
+  cursor?: string
   sort?: 'size_desc' | 'name_asc'
   includeFiles?: boolean
 }
@@ -24,6 +37,36 @@ export interface ChildRequest {
 export interface ChildResponse {
   items: ItemRecord[]
   total: number
+  /** Present when more rows may follow this page. */
+  nextCursor?: string
+}
+
+/** One recorded scan of a root; see the scan history in db.ts. */
+export interface SnapshotInfo {
+  id: number
+  rootPath: string
+  runId: string
+  takenMs: number
+}
+
+export interface FolderSizeAt {
+  sizeBytes: number
+  fileCount: number
+  folderCount: number
+}
+
+export interface GrowthRequest {
+  parent: string
+  /** Compare against the folder sizes as of this snapshot. */
+  snapshotId: number
+  limit?: number
+}
+
+/** A subfolder's size now and at an earlier snapshot (null: not recorded then). */
+export interface GrowthEntry {
+  path: string
+  sizeBytes: number
+  thenBytes: number | null
 }
 
 export interface TopRequest {
@@ -31,11 +74,82 @@ export interface TopRequest {
   type: 'File' | 'Folder'
 }
 
+/** A top list read straight from a scan file, optionally below one of its folders. */
+export interface ScanFileTopRequest extends TopRequest {
+  under?: string
+}
+
+export interface SearchRequest {
+  /** Part of a name (`backup-2023`), or a whole-name pattern with `*` and `?` (`*.vmdk`). */
+  query: string
+  type?: ItemType
+  minBytes?: number
+  maxBytes?: number
+  /** Modified at or after / before this time, epoch ms. */
+  modifiedAfterMs?: number
+  modifiedBeforeMs?: number
+  /** Most results kept, largest first; defaults to 500. */
+  limit?: number
+}
+
+/** The best matches of a search so far, largest first; sent as it runs. */
+export interface SearchStatus {
+  searchId: string
+  state: 'running' | 'completed' | 'error' | 'cancelled'
+  message?: string
+  items: ItemRecord[]
+}
+
+export interface FilterRequest {
+  /** Filter text, e.g. `type:file size>1G modified<2023-01-01 ext:iso,vmdk under:/data`; see filter.ts. */
+  query: string
+  /** Most rows sent in all; defaults to 1000. */
+  limit?: number
+}
+
+/** The next page of a filter's rows, largest first, following those sent before. */
+export interface FilterPage {
+  filterId: string
+  state: 'running' | 'completed' | 'error' | 'cancelled'
+  message?: string
+  items: ItemRecord[]
+}
+
+export type CompareOp = '<' | '<=' | '=' | '>=' | '>'
+
+/** One condition of a parsed filter; a filter holds where all its terms do. */
+export type FilterTerm =
+  | { kind: 'type'; type: ItemType }
+  | { kind: 'size'; op: CompareOp; bytes: number }
+  | { kind: 'modified'; op: CompareOp; ms: number }
+  /** The name contains `text`, or matches it whole when it has `*` or `?`. */
+  | { kind: 'name'; text: string }
+  /** Anywhere below the folder `path`. */
+  | { kind: 'under'; path: string }
+  | { kind: 'all'; terms: FilterTerm[] }
+  | { kind: 'any'; terms: FilterTerm[] }
+  | { kind: 'not'; term: FilterTerm }
+
 export interface ScanRequest {
   startPath: string
   mode?: 'full' | 'shallow'
-  /** Skip directories already deep-scanned after this ISO date. */
-  skipScannedAfter?: string
+  /** Skip directories already deep-scanned after this time (epoch ms). */
+  skipScannedAfter?: number
+  /** Defaults to 'auto'. */
+  latencyMode?: LatencyMode
+  /** Most individual file rows a full scan keeps; defaults to 250 000. */
+  fileRowBudget?: number
+  /** Full scans only: scan these roots together instead of startPath. */
+  startPaths?: string[]
+}
+
+/** Progress of one root within a multi-root scan. */
+export interface RootProgress {
+  path: string
+  state: 'queued' | 'running' | 'completed' | 'cancelled'
+  itemsScanned: number
+  bytesSeen?: number
+  percent?: number
 }
 
 export interface ScanResult {
@@ -47,6 +161,11 @@ export interface ScanStatus {
   state: 'running' | 'completed' | 'error' | 'cancelled'
   message?: string
   itemsScanned?: number
+  bytesSeen?: number
+  /** Estimated completion (0–100), when the scan has something to go by. */
+  percent?: number
+  etaSeconds?: number
+  roots?: RootProgress[]
   currentPath?: string
 }
 
@@ -54,7 +173,12 @@ export interface ListDirEntry {
   name: string
   isDirectory: boolean
   sizeBytes: number
-  lastWriteUtc: string
+  /** Epoch ms. */
+  lastWriteMs: number
+  /** Packed size, for entries inside an archive (when known). */
+  compressedBytes?: number
+  /** An archive file whose contents can be browsed like a folder. */
+  isArchive?: boolean
 }
 
 export interface ListDirResponse {
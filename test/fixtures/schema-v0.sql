@@ -0,0 +1,17 @@
+-- The original layout (PRAGMA user_version 0): one row per full path,
+-- timestamps as ISO-8601 text. Kept to test the upgrade to the node tree.
+CREATE TABLE IF NOT EXISTS items (
+  path TEXT PRIMARY KEY,
+  parent TEXT,
+  type TEXT NOT NULL,
+  sizeBytes INTEGER NOT NULL,
+  fileCount INTEGER NOT NULL,
+  folderCount INTEGER NOT NULL,
+  lastWriteUtc TEXT NOT NULL,
+  scannedUtc TEXT NOT NULL,
+  depth INTEGER NOT NULL,
+  runId TEXT NOT NULL
+);
+CREATE INDEX IF NOT EXISTS idx_items_parent ON items(parent);
+CREATE INDEX IF NOT EXISTS idx_items_size ON items(sizeBytes DESC);
+CREATE INDEX IF NOT EXISTS idx_items_type ON items(type);
@@ -2,6 +2,9 @@ import { test, expect, _electron as electron, ElectronApplication, Page } from '
 import path from 'node:path'
 import fs from 'node:fs'
 import os from 'node:os'
+import { execFileSync } from 'node:child_process'
+import { createHash } from 'node:crypto'
+import initSqlJs from 'sql.js'
 import type { LfbApi } from '../src/preload/preload'
 
 declare global {
@@ -11,6 +14,8 @@ declare global {
 }
 
 const projectRoot = path.resolve(__dirname, '..')
+/** The compiled main entry; app.evaluate() requires the main modules relative to it. */
+const mainEntry = path.join(projectRoot, 'dist', 'main', 'main.js')
 
 /* ---------- temp fixtures ---------- */
 
@@ -30,8 +35,13 @@ function createFixtures() {
 
 /* ---------- helpers ---------- */
 
-async function launch(): Promise<{ app: ElectronApplication; page: Page }> {
-  const app = await electron.launch({ args: ['.'], cwd: projectRoot, timeout: 30_000 })
+async function launch(env?: Record<string, string>): Promise<{ app: ElectronApplication; page: Page }> {
+  const app = await electron.launch({
+    args: ['.'],
+    cwd: projectRoot,
+    timeout: 30_000,
+    env: env ? ({ ...process.env, ...env } as Record<string, string>) : undefined
+  })
   const page = await app.firstWindow()
   await page.waitForLoadState('domcontentloaded')
   return { app, page }
@@ -51,6 +61,35 @@ async function seedFolder(page: Page, dir: string) {
   await page.getByTestId('refresh-btn').click()
 }
 
+/** Run a full scan of `dir` (or several roots) and resolve with its final status. */
+async function scanAndWait(
+  page: Page,
+  dir: string | string[],
+  options: { skipScannedAfter?: number; fileRowBudget?: number } = {}
+): Promise<any> {
+  const dirs = Array.isArray(dir) ? dir : [dir]
+  return page.evaluate(
+    async ({ dirs, skip, budget }) => new Promise<any>((resolve) => {
+      const unsub = window.lfb.onScanStatus((status: any) => {
+        if (status.state !== 'running') { unsub(); resolve(status) }
+      })
+      window.lfb.scan({
+        startPath: dirs[0],
+        startPaths: dirs.length > 1 ? dirs : undefined,
+        mode: 'full',
+        skipScannedAfter: skip,
+        fileRowBudget: budget
+      })
+    }),
+    { dirs, skip: options.skipScannedAfter, budget: options.fileRowBudget }
+  )
+}
+
+/** The name part of a scan root's shard file, as shards.ts derives it. */
+function shardHash(root: string): string {
+  return createHash('sha1').update(root).digest('hex').slice(0, 16)
+}
+
 /* ================================================================
    Level 0 — Does the app even launch?
    ================================================================ */
@@ -62,6 +101,77 @@ test('app launches and window is visible', async () => {
   await app.close()
 })
 
+test('picks the native engine when present, sql.js when asked', async () => {
+  test.setTimeout(60_000)
+  const dataDir = path.join(projectRoot, 'data')
+  for (const engine of ['native', 'sqljs']) {
+    const { app, page } = await launch(engine === 'sqljs' ? { LFB_SQLITE_ENGINE: 'sqljs' } : undefined)
+    // Older runtimes lack node:sqlite and fall back on their own
+    const hasNative = await app.evaluate(() => {
+      try {
+        return !!(process as any).getBuiltinModule?.('node:sqlite')
+      } catch {
+        return false
+      }
+    })
+    const native = engine === 'native' && hasNative
+    await resetAndWait(page)
+    const t0 = Date.now()
+    await page.evaluate((d: string) => window.lfb.scan({ startPath: d, mode: 'shallow' }), projectRoot)
+
+    // Native databases run in WAL mode: the scan's rows land in a -wal file
+    const wal = fs.readdirSync(dataDir)
+      .some((f) => f.endsWith('.sqlite-wal') && fs.statSync(path.join(dataDir, f)).mtimeMs >= t0)
+    expect(wal).toBe(native)
+    // Only the in-memory fallback gets the larger heap
+    const flags = await app.evaluate(({ app: a }) => a.commandLine.getSwitchValue('js-flags'))
+    expect(flags.includes('--max-old-space-size')).toBe(!native)
+    await app.close()
+  }
+})
+
+test('libuv threadpool is widened in the main process', async () => {
+  // A FIFO open blocks its pool thread until a writer shows up
+  test.skip(process.platform === 'win32', 'needs mkfifo')
+  const fifo = path.join(os.tmpdir(), `lfb-fifo-${Date.now()}`)
+  execFileSync('mkfifo', [fifo])
+  const { app } = await launch()
+  const free = await app.evaluate(async (_electron, p: string) => {
+    const fsm = (process as any).getBuiltinModule('node:fs')
+    // Tie up more threads than the default pool of 4 has
+    const BLOCKERS = 8
+    let opened = 0
+    for (let i = 0; i < BLOCKERS; i++) {
+      fsm.open(p, 'r', (err: any, fd: number) => {
+        opened++
+        if (!err) fsm.close(fd, () => {})
+      })
+    }
+    // Only a wider pool has a thread left for this
+    const answered = await new Promise<boolean>((resolve) => {
+      const timer = setTimeout(() => resolve(false), 2_000)
+      fsm.stat(p, () => {
+        clearTimeout(timer)
+        resolve(true)
+      })
+    })
+    // Let every blocked open through before quitting
+    const { O_WRONLY, O_NONBLOCK } = fsm.constants
+    while (opened < BLOCKERS) {
+      try {
+        fsm.closeSync(fsm.openSync(p, O_WRONLY | O_NONBLOCK))
+      } catch {
+        // No reader waiting yet
+      }
+      await new Promise((r) => setTimeout(r, 10))
+    }
+    return answered
+  }, fifo)
+  expect(free).toBe(true)
+  await app.close()
+  fs.rmSync(fifo, { force: true })
+})
+
 /* ================================================================
    Level 1 — Empty state & basic controls
    ================================================================ */
@@ -261,6 +371,409 @@ test.describe('with fixtures', () => {
     await app.close()
   })
 
+  test('incremental scan re-parents a renamed folder instead of rescanning', async () => {
+    test.setTimeout(60_000)
+    const moveRoot = path.join(os.tmpdir(), `lfb-move-${Date.now()}`)
+    fs.mkdirSync(path.join(moveRoot, 'project', 'src'), { recursive: true })
+    fs.writeFileSync(path.join(moveRoot, 'project', 'src', 'blob.bin'), 'g'.repeat(150_000))
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+
+    await scanAndWait(page, moveRoot)
+    fs.renameSync(path.join(moveRoot, 'project'), path.join(moveRoot, 'renamed'))
+    await scanAndWait(page, moveRoot, { skipScannedAfter: Date.now() - 60_000 })
+
+    const children = (parent: string) => page.evaluate((p: string) => window.lfb.children({ parent: p }), parent)
+    expect((await children(path.join(moveRoot, 'project'))).total).toBe(0)
+    const moved = await children(path.join(moveRoot, 'renamed', 'src'))
+    expect(moved.items.map((r: any) => r.path)).toEqual([path.join(moveRoot, 'renamed', 'src', 'blob.bin')])
+
+    await app.close()
+    fs.rmSync(moveRoot, { recursive: true, force: true })
+  })
+
+  test('a parent scan takes over the shard of a root scanned below it', async () => {
+    test.setTimeout(60_000)
+    const parent = path.join(os.tmpdir(), `lfb-nest-${Date.now()}`)
+    const nested = path.join(parent, 'nested')
+    for (const d of [path.join(nested, 'one'), path.join(parent, 'other')]) {
+      fs.mkdirSync(d, { recursive: true })
+      for (let f = 0; f < 5; f++) fs.writeFileSync(path.join(d, `file-${f}.bin`), 'n'.repeat(10_000))
+    }
+    const nestedShard = path.join(projectRoot, 'data', `shard-${shardHash(nested)}.sqlite`)
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    const t0 = Date.now()
+    await scanAndWait(page, nested)
+    await expect.poll(() => fs.existsSync(nestedShard)).toBe(true)
+
+    // The incremental parent scan reuses the nested rows, then retires their shard
+    expect((await scanAndWait(page, parent, { skipScannedAfter: t0 })).state).toBe('completed')
+    await expect.poll(() => fs.existsSync(nestedShard)).toBe(false)
+    const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+    const listed = roots.items.map((r: any) => r.path)
+    expect(listed).toContain(parent)
+    expect(listed).not.toContain(nested)
+    expect(roots.items.find((r: any) => r.path === parent).sizeBytes).toBe(100_000)
+    const one = await page.evaluate((p: string) => window.lfb.children({ parent: p }), path.join(nested, 'one'))
+    expect(one.total).toBe(5)
+
+    await app.close()
+    fs.rmSync(parent, { recursive: true, force: true })
+  })
+
+  test('a root scanned below another is subsumed, and stays so when renamed', async () => {
+    test.setTimeout(60_000)
+    const parent = path.join(os.tmpdir(), `lfb-subsume-${Date.now()}`)
+    const sub = path.join(parent, 'sub')
+    fs.mkdirSync(sub, { recursive: true })
+    for (let f = 0; f < 3; f++) fs.writeFileSync(path.join(sub, `file-${f}.bin`), 's'.repeat(10_000))
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    const rootPaths = async () => (await page.evaluate(() => window.lfb.children({ parent: null })))
+      .items.map((r: any) => r.path).filter((p: string) => p.startsWith(parent))
+
+    const t0 = Date.now()
+    await scanAndWait(page, parent)
+    await scanAndWait(page, sub)
+    expect(await rootPaths()).toEqual([parent])
+
+    // The renamed folder is adopted by the parent scan, not listed as a root again
+    const renamed = path.join(parent, 'renamed')
+    fs.renameSync(sub, renamed)
+    expect((await scanAndWait(page, parent, { skipScannedAfter: t0 })).state).toBe('completed')
+    expect(await rootPaths()).toEqual([parent])
+    const moved = await page.evaluate((p: string) => window.lfb.children({ parent: p }), renamed)
+    expect(moved.total).toBe(3)
+
+    await app.close()
+    fs.rmSync(parent, { recursive: true, force: true })
+  })
+
+  test('a cancelled parent scan keeps the shard of a root scanned below it', async () => {
+    test.setTimeout(60_000)
+    const parent = path.join(os.tmpdir(), `lfb-nestcancel-${Date.now()}`)
+    const nested = path.join(parent, 'nested')
+    fs.mkdirSync(nested, { recursive: true })
+    for (let f = 0; f < 5; f++) fs.writeFileSync(path.join(nested, `file-${f}.bin`), 'n'.repeat(10_000))
+    for (let d = 0; d < 30; d++) {
+      const dir = path.join(parent, `dir-${d}`)
+      fs.mkdirSync(dir)
+      for (let f = 0; f < 20; f++) fs.writeFileSync(path.join(dir, `file-${f}.bin`), 'x')
+    }
+    const nestedShard = path.join(projectRoot, 'data', `shard-${shardHash(nested)}.sqlite`)
+
+    const { app, page } = await launch({ LFB_FS_LATENCY_MS: '20' })
+    await resetAndWait(page)
+    await scanAndWait(page, nested)
+    const state = await page.evaluate(async (dir: string) => new Promise<string>((resolve) => {
+      let cancelled = false
+      const unsub = window.lfb.onScanStatus((status: any) => {
+        if (status.state === 'running' && status.itemsScanned > 0 && !cancelled) {
+          cancelled = true
+          window.lfb.cancelScan(status.runId)
+        } else if (status.state !== 'running') {
+          unsub()
+          resolve(status.state)
+        }
+      })
+      window.lfb.scan({ startPath: dir, mode: 'full' })
+    }), parent)
+    expect(state).toBe('cancelled')
+
+    // Nothing was rewritten in full, so the nested shard and its rows stay
+    await page.waitForTimeout(500)
+    expect(fs.existsSync(nestedShard)).toBe(true)
+    const rows = await page.evaluate((p: string) => window.lfb.children({ parent: p }), nested)
+    expect(rows.total).toBe(5)
+    // ...and the root view counts them once
+    const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+    expect(roots.items.filter((r: any) => r.path === parent || r.path === nested)).toHaveLength(1)
+
+    // A finished parent scan takes over
+    expect((await scanAndWait(page, parent)).state).toBe('completed')
+    await expect.poll(() => fs.existsSync(nestedShard)).toBe(false)
+    const after = await page.evaluate(() => window.lfb.children({ parent: null }))
+    expect(after.items.map((r: any) => r.path)).toContain(parent)
+    expect(after.items.map((r: any) => r.path)).not.toContain(nested)
+
+    await app.close()
+    fs.rmSync(parent, { recursive: true, force: true })
+  })
+
+  test('rescan sweeps deleted entries but keeps unreadable folders', async () => {
+    test.setTimeout(60_000)
+    const root = path.join(os.tmpdir(), `lfb-sweep-${Date.now()}`)
+    const locked = path.join(root, 'locked')
+    fs.mkdirSync(locked, { recursive: true })
+    fs.writeFileSync(path.join(locked, 'kept.bin'), 'k'.repeat(5_000))
+    fs.writeFileSync(path.join(root, 'gone.bin'), 'g'.repeat(7_000))
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    const children = async (p: string) => {
+      const listed = await page.evaluate((dir: string) => window.lfb.children({ parent: dir }), p)
+      return listed.items.map((r: any) => r.path)
+    }
+
+    await scanAndWait(page, root)
+    fs.rmSync(path.join(root, 'gone.bin'))
+    await scanAndWait(page, root)
+    expect(await children(root)).toEqual([locked])
+
+    // chmod cannot lock out root, nor a folder on Windows
+    if (process.platform !== 'win32' && process.getuid?.() !== 0) {
+      fs.chmodSync(locked, 0)
+      try {
+        await scanAndWait(page, root)
+      } finally {
+        fs.chmodSync(locked, 0o755)
+      }
+      expect(await children(locked)).toEqual([path.join(locked, 'kept.bin')])
+    }
+
+    await app.close()
+    fs.rmSync(root, { recursive: true, force: true })
+  })
+
+  test('snapshots record growth and keep the history of deleted folders', async () => {
+    test.setTimeout(60_000)
+    const root = path.join(os.tmpdir(), `lfb-history-${Date.now()}`)
+    for (const d of ['keep', 'grows', path.join('doomed', 'inner')]) fs.mkdirSync(path.join(root, d), { recursive: true })
+    fs.writeFileSync(path.join(root, 'keep', 'a.bin'), 'a'.repeat(1_000))
+    fs.writeFileSync(path.join(root, 'grows', 'b.bin'), 'b'.repeat(100))
+    fs.writeFileSync(path.join(root, 'doomed', 'inner', 'c.bin'), 'c'.repeat(4_000))
+    const doomed = path.join(root, 'doomed')
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, root)
+    const [first] = await page.evaluate((p: string) => window.lfb.snapshots(p), root)
+    expect(first.rootPath).toBe(root)
+    expect(await page.evaluate(({ p, id }) => window.lfb.sizeAt(p, id), { p: root, id: first.id }))
+      .toEqual({ sizeBytes: 5_100, fileCount: 3, folderCount: 4 })
+
+    fs.writeFileSync(path.join(root, 'grows', 'd.bin'), 'd'.repeat(3_000))
+    fs.rmSync(doomed, { recursive: true })
+    await scanAndWait(page, root)
+    const snapshots = await page.evaluate((p: string) => window.lfb.snapshots(p), root)
+    expect(snapshots.map((s: any) => s.id)).toEqual([snapshots[0].id, first.id])
+
+    const growth = await page.evaluate(({ p, id }) => window.lfb.growth({ parent: p, snapshotId: id }), { p: root, id: first.id })
+    expect(growth.map((g: any) => [path.basename(g.path), g.sizeBytes, g.thenBytes])).toEqual([
+      ['grows', 3_100, 100],
+      ['keep', 1_000, 1_000],
+      ['doomed', 0, 4_000]
+    ])
+    // The deleted folder's past survives the sweep; it is absent from later snapshots
+    expect(await page.evaluate(({ p, id }) => window.lfb.sizeAt(p, id), { p: path.join(doomed, 'inner'), id: first.id }))
+      .toEqual({ sizeBytes: 4_000, fileCount: 1, folderCount: 0 })
+    expect(await page.evaluate(({ p, id }) => window.lfb.sizeAt(p, id), { p: doomed, id: snapshots[0].id })).toBeNull()
+
+    await app.close()
+    fs.rmSync(root, { recursive: true, force: true })
+  })
+
+  test('folder listings page by cursor and keep their counts current', async () => {
+    test.setTimeout(60_000)
+    const root = path.join(os.tmpdir(), `lfb-paging-${Date.now()}`)
+    for (const d of ['alpha', 'beta', path.join('gamma', 'inner')]) fs.mkdirSync(path.join(root, d), { recursive: true })
+    for (let i = 0; i < 5; i++) fs.writeFileSync(path.join(root, `file-${i}.bin`), 'x'.repeat(1_000 * (i + 1)))
+    fs.writeFileSync(path.join(root, 'gamma', 'g.bin'), 'g'.repeat(500))
+
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, root)
+    const children = (req: any) => page.evaluate((r: any) => window.lfb.children(r), req)
+    const names = (listed: any) => listed.items.map((r: any) => path.basename(r.path))
+
+    // Pages of two, each continuing from the previous cursor, add up to one listing
+    for (const sort of ['size_desc', 'name_asc']) {
+      const whole = await children({ parent: root, sort })
+      const paged: string[] = []
+      let cursor: string | undefined
+      do {
+        const pageOf = await children({ parent: root, sort, limit: 2, cursor })
+        expect(pageOf.total).toBe(8)
+        paged.push(...names(pageOf))
+        cursor = pageOf.nextCursor
+      } while (cursor)
+      expect(paged).toEqual(names(whole))
+    }
+    await expect(children({ parent: root, cursor: 's:0:0', offset: 2 })).rejects.toThrow(/cursor or offset/)
+    // A cursor of the other sort order would restart at page 1 forever
+    await expect(children({ parent: root, sort: 'name_asc', cursor: 's:0:0' })).rejects.toThrow(/not a name_asc cursor/)
+    await expect(children({ parent: root, sort: 'size_desc', cursor: 'n:beta' })).rejects.toThrow(/not a size_desc cursor/)
+
+    // Insert, delete and move, each followed by an incremental rescan
+    const totals = async (p: string) => [(await children({ parent: p })).total, (await children({ parent: p, includeFiles: false })).total]
+    expect(await totals(root)).toEqual([8, 3])
+    fs.mkdirSync(path.join(root, 'delta'))
+    fs.writeFileSync(path.join(root, 'delta', 'd.bin'), 'd'.repeat(10))
+    await scanAndWait(page, root, { skipScannedAfter: Date.now() - 60_000 })
+    expect(await totals(root)).toEqual([9, 4])
+    fs.rmSync(path.join(root, 'alpha'), { recursive: true })
+    fs.rmSync(path.join(root, 'file-0.bin'))
+    await scanAndWait(page, root, { skipScannedAfter: Date.now() - 60_000 })
+    expect(await totals(root)).toEqual([7, 3])
+    // A cutoff of now walks every folder again; the move is still adopted by inode
+    fs.renameSync(path.join(root, 'gamma'), path.join(root, 'beta', 'gamma'))
+    await scanAndWait(page, root, { skipScannedAfter: Date.now() })
+    expect(await totals(root)).toEqual([6, 2])
+    expect(await totals(path.join(root, 'beta'))).toEqual([1, 1])
+    expect(await totals(path.join(root, 'beta', 'gamma'))).toEqual([2, 1])
+
+    await app.close()
+    fs.rmSync(root, { recursive: true, force: true })
+  })
+
+  test('full scan keeps the largest files of every folder, however small', async () => {
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, testDir)
+
+    // tiny.txt (10 bytes) used to fall under the fixed 100 KB cutoff
+    const top = await page.evaluate(() => window.lfb.top({ type: 'File', limit: 100 }))
+    const names = top.map((r: any) => path.basename(r.path)).sort()
+    expect(names).toEqual(['big.txt', 'deep.txt', 'file.txt', 'medium.txt', 'small.txt', 'tiny.txt'])
+    await app.close()
+  })
+
+  test('one scan request covers several roots and reports each', async () => {
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    const roots = [path.join(testDir, 'subdir-a'), path.join(testDir, 'subdir-b')]
+    const final = await scanAndWait(page, roots)
+
+    expect(final.state).toBe('completed')
+    expect(final.roots.map((r: any) => [r.path, r.state])).toEqual(roots.map((r) => [r, 'completed']))
+    const listed = await page.evaluate(() => window.lfb.children({ parent: null }))
+    const size = (p: string) => listed.items.find((r: any) => r.path === p)?.sizeBytes
+    expect(size(roots[0])).toBe(200_010)
+    expect(size(roots[1])).toBe(130_000)
+    await app.close()
+  })
+
+  test('name search finds matches anywhere, largest first, with filters', async () => {
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, testDir)
+
+    const search = (req: any) => page.evaluate(
+      async (r: any) => new Promise<any>((resolve) => {
+        const unsub = window.lfb.onSearchStatus((status: any) => {
+          if (status.state !== 'running') { unsub(); resolve(status) }
+        })
+        window.lfb.search(r)
+      }),
+      req
+    )
+    const names = (status: any) => status.items.map((r: any) => path.basename(r.path))
+
+    const all = await search({ query: 'TXT' })
+    expect(all.state).toBe('completed')
+    expect(names(all)).toEqual(['big.txt', 'deep.txt', 'medium.txt', 'file.txt', 'small.txt', 'tiny.txt'])
+    expect(names(await search({ query: '*.txt', minBytes: 50_000, limit: 2 }))).toEqual(['big.txt', 'deep.txt'])
+    expect(names(await search({ query: 'nest', type: 'Folder' }))).toEqual(['nested'])
+    expect(names(await search({ query: 'd?ep.*' }))).toEqual(['deep.txt'])
+    expect(names(await search({ query: 'txt', modifiedAfterMs: Date.now() + 60_000 }))).toEqual([])
+    await app.close()
+  })
+
+  test('filter queries stream matching rows largest first', async () => {
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, testDir)
+
+    const filter = (query: string, limit?: number) => page.evaluate(
+      async ({ q, l }) => new Promise<any>((resolve) => {
+        const items: any[] = []
+        const unsub = window.lfb.onFilterPage((p: any) => {
+          items.push(...p.items)
+          if (p.state !== 'running') { unsub(); resolve({ state: p.state, items }) }
+        })
+        window.lfb.filter({ query: q, limit: l })
+      }),
+      { q: query, l: limit }
+    )
+    const names = (result: any) => result.items.map((r: any) => path.basename(r.path))
+
+    const big = await filter('type:file size>40K')
+    expect(big.state).toBe('completed')
+    expect(names(big)).toEqual(['big.txt', 'deep.txt', 'medium.txt'])
+    expect(names(await filter(`ext:txt under:"${path.join(testDir, 'subdir-b')}"`))).toEqual(['deep.txt', 'file.txt'])
+    expect(names(await filter('type:folder -nest'))).toEqual([path.basename(testDir), 'subdir-a', 'subdir-b'])
+    expect(names(await filter('ext:txt', 2))).toEqual(['big.txt', 'deep.txt'])
+    expect(names(await filter('modified>2999-01-01'))).toEqual([])
+    await expect(page.evaluate(() => window.lfb.filter({ query: 'size>lots' }))).rejects.toThrow(/Not a size/)
+    await app.close()
+  })
+
+  test('scan files export, answer queries in place and import', async () => {
+    const scanPath = path.join(os.tmpdir(), `lfb-export-${Date.now()}.lfbscan`)
+    const { app, page } = await launch()
+    await resetAndWait(page)
+    await scanAndWait(page, testDir)
+
+    const exported = await page.evaluate(({ dir, file }) => window.lfb.exportScan(dir, file), { dir: testDir, file: scanPath })
+    expect(exported.ok).toBe(true)
+    const top = await page.evaluate((file: string) => window.lfb.scanFileTop(file, { type: 'File', limit: 2 }), scanPath)
+    expect(top.map((r: any) => path.basename(r.path))).toEqual(['big.txt', 'deep.txt'])
+    const under = await page.evaluate(
+      ({ file, dir }) => window.lfb.scanFileTop(file, { type: 'File', under: dir }),
+      { file: scanPath, dir: path.join(testDir, 'subdir-b') }
+    )
+    expect(under.map((r: any) => path.basename(r.path))).toEqual(['deep.txt', 'file.txt'])
+    const listed = await page.evaluate(({ file, dir }) => window.lfb.scanFileChildren(file, { parent: dir }), { file: scanPath, dir: testDir })
+    expect(listed.total).toBe(4)
+    expect(listed.items[0].path).toBe(path.join(testDir, 'subdir-a'))
+
+    await resetAndWait(page)
+    const imported = await page.evaluate((file: string) => window.lfb.importScan(file), scanPath)
+    expect(imported.rootPath).toBe(testDir)
+    const children = await page.evaluate((dir: string) => window.lfb.children({ parent: dir }), testDir)
+    expect(children.items.map((r: any) => path.basename(r.path))).toEqual(
+      listed.items.map((r: any) => path.basename(r.path))
+    )
+    await app.close()
+    fs.rmSync(scanPath, { force: true })
+  })
+
+  test('archive contents list as virtual folders with their sizes', async () => {
+    const tarPath = path.join(os.tmpdir(), `lfb-archive-${Date.now()}.tar`)
+    execFileSync('tar', ['-cf', tarPath, '-C', testDir, 'subdir-b'])
+    const { app, page } = await launch()
+
+    const outer = await page.evaluate((dir: string) => window.lfb.listDir(dir), path.dirname(tarPath))
+    expect(outer.entries.find((e) => e.name === path.basename(tarPath))?.isArchive).toBe(true)
+
+    const top = await page.evaluate((p: string) => window.lfb.listDir(p), tarPath)
+    expect(top.entries.map((e) => [e.name, e.isDirectory, e.sizeBytes])).toEqual([['subdir-b', true, 130_000]])
+    const nested = await page.evaluate((p: string) => window.lfb.listDir(p), path.join(tarPath, 'subdir-b', 'nested'))
+    expect(nested.entries.map((e) => [e.name, e.sizeBytes])).toEqual([['deep.txt', 100_000]])
+    expect(nested.parentPath).toBe(path.join(tarPath, 'subdir-b'))
+    await app.close()
+    fs.rmSync(tarPath, { force: true })
+  })
+
+  test('a compressed tarball that inflates past the cap lists nothing', async () => {
+    const bombDir = path.join(os.tmpdir(), `lfb-bomb-${Date.now()}`)
+    fs.mkdirSync(bombDir)
+    fs.writeFileSync(path.join(bombDir, 'zeros.bin'), Buffer.alloc(4 * 1024 * 1024))
+    const tgzPath = `${bombDir}.tgz`
+    execFileSync('tar', ['-czf', tgzPath, '-C', bombDir, 'zeros.bin'])
+    const { app, page } = await launch({ LFB_ARCHIVE_MAX_MB: '1' })
+
+    const top = await page.evaluate((p: string) => window.lfb.listDir(p), tgzPath)
+    expect(top.entries).toEqual([])
+    await app.close()
+    fs.rmSync(bombDir, { recursive: true, force: true })
+    fs.rmSync(tgzPath, { force: true })
+  })
+
   test('scanned data persists after app restart', async () => {
     // 1. Launch, reset, scan fixture folder
     const { app: app1, page: page1 } = await launch()
@@ -291,6 +804,127 @@ test.describe('with fixtures', () => {
     await app2.close()
   })
 
+  test('a version 0 database is upgraded to the node tree', async () => {
+    test.setTimeout(60_000)
+    // A scratch data directory; the checkout's own data/ is left alone
+    const dataDir = path.join(os.tmpdir(), `lfb-v0-data-${Date.now()}`)
+    const root = path.join(os.tmpdir(), 'lfb-v0', 'scanned')
+    const when = '2024-03-01T10:00:00.000Z'
+    const scanned = '2024-03-02T08:30:00.000Z'
+    // path, type, size, files, folders, depth — as the first release wrote them
+    const rows: [string, string, number, number, number, number][] = [
+      [root, 'Folder', 3000, 3, 2, 0],
+      [path.join(root, 'a'), 'Folder', 2000, 2, 0, 1],
+      [path.join(root, 'a', 'big.bin'), 'File', 1500, 1, 0, 2],
+      [path.join(root, 'a', 'small.bin'), 'File', 500, 1, 0, 2],
+      [path.join(root, 'b'), 'Folder', 1000, 1, 0, 1],
+      [path.join(root, 'b', 'c.bin'), 'File', 1000, 1, 0, 2]
+    ]
+
+    for (const engine of ['native', 'sqljs']) {
+      // Only the old single file, no catalog: it is adopted as the first shard
+      fs.rmSync(dataDir, { recursive: true, force: true })
+      fs.mkdirSync(dataDir, { recursive: true })
+      const SQL = await initSqlJs()
+      const v0 = new SQL.Database()
+      v0.run(fs.readFileSync(path.join(__dirname, 'fixtures', 'schema-v0.sql'), 'utf8'))
+      const insert = v0.prepare('INSERT INTO items VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)')
+      for (const [p, type, size, files, folders, depth] of rows) {
+        insert.run([p, path.dirname(p), type, size, files, folders, when, scanned, depth, 'run-v0'])
+      }
+      insert.free()
+      fs.writeFileSync(path.join(dataDir, 'lfb.sqlite'), Buffer.from(v0.export()))
+      v0.close()
+
+      const env: Record<string, string> = { LFB_DATA_DIR: dataDir }
+      if (engine === 'sqljs') env.LFB_SQLITE_ENGINE = 'sqljs'
+      const { app, page } = await launch(env)
+      const children = (parent: string | null) => page.evaluate((p) => window.lfb.children({ parent: p }), parent)
+      // The scan root hangs off nodes it had no row for, and is still a root
+      const roots = await children(null)
+      expect(roots.items.map((r: any) => [r.path, r.sizeBytes])).toEqual([[root, 3000]])
+      expect(roots.items[0].scannedMs).toBe(Date.parse(scanned))
+      // Every level is answered from the tree, with counts kept per folder
+      const top = await children(root)
+      expect(top.total).toBe(2)
+      expect(top.items.map((r: any) => [path.basename(r.path), r.sizeBytes, r.fileCount])).toEqual([['a', 2000, 2], ['b', 1000, 1]])
+      const a = await children(path.join(root, 'a'))
+      expect(a.items.map((r: any) => [path.basename(r.path), r.depth, r.lastWriteMs]))
+        .toEqual([['big.bin', 2, Date.parse(when)], ['small.bin', 2, Date.parse(when)]])
+      expect((await children(path.join(root, 'b'))).total).toBe(1)
+      await app.close()
+    }
+    fs.rmSync(dataDir, { recursive: true, force: true })
+  })
+
+  test('quit still saves when the background writer dies', async () => {
+    test.setTimeout(60_000)
+    // The sql.js engine is the one that saves through the writer
+    const env = { LFB_SQLITE_ENGINE: 'sqljs', LFB_PERSIST_WORKER: 'crash' }
+    const first = await launch(env)
+    await resetAndWait(first.page)
+    await scanAndWait(first.page, testDir)
+    await first.app.close()
+
+    const { app, page } = await launch({ LFB_SQLITE_ENGINE: 'sqljs' })
+    const children = await page.evaluate((dir: string) => window.lfb.children({ parent: dir }), testDir)
+    expect(children.total).toBe(4)
+    await app.close()
+  })
+
+  test('a committed save journal is replayed after a crash', async () => {
+    test.setTimeout(60_000)
+    const env = { LFB_SQLITE_ENGINE: 'sqljs' }
+    const dataDir = path.join(projectRoot, 'data')
+    const nested = path.join(testDir, 'subdir-b', 'nested')
+
+    // Before: a shallow scan knows nothing below the root's children
+    let run = await launch(env)
+    await resetAndWait(run.page)
+    await seedFolder(run.page, testDir)
+    await run.app.close()
+    // The shard that seeding just wrote
+    const shardPath = fs.readdirSync(dataDir)
+      .filter((f) => /^shard-.*\.sqlite$/.test(f))
+      .map((f) => path.join(dataDir, f))
+      .sort((a, b) => fs.statSync(b).mtimeMs - fs.statSync(a).mtimeMs)[0]
+    const before = fs.readFileSync(shardPath)
+
+    // After: a full scan of the same root, saved into the same shard
+    run = await launch(env)
+    await scanAndWait(run.page, testDir)
+    await run.app.close()
+    const after = fs.readFileSync(shardPath)
+
+    // Put back the old file plus the journal a save leaves once committed,
+    // as if the app died before copying the pages into place
+    const v = after.readUInt16BE(16)
+    const pageSize = v === 1 ? 65_536 : v
+    const pages: number[] = []
+    for (let p = 0; p * pageSize < after.length; p++) {
+      const page = after.subarray(p * pageSize, (p + 1) * pageSize)
+      if (!page.equals(before.subarray(p * pageSize, (p + 1) * pageSize))) pages.push(p)
+    }
+    const journal = Buffer.alloc(16 + pages.length * (4 + pageSize))
+    journal.writeUInt32LE(0x4c46424a, 0) // committed
+    journal.writeUInt32LE(pageSize, 4)
+    journal.writeUInt32LE(pages.length, 8)
+    journal.writeUInt32LE(after.length / pageSize, 12)
+    pages.forEach((p, i) => {
+      const at = 16 + i * (4 + pageSize)
+      journal.writeUInt32LE(p, at)
+      after.copy(journal, at + 4, p * pageSize, (p + 1) * pageSize)
+    })
+    fs.writeFileSync(shardPath, before)
+    fs.writeFileSync(`${shardPath}-pj`, journal)
+
+    run = await launch(env)
+    const listed = await run.page.evaluate((dir: string) => window.lfb.children({ parent: dir }), nested)
+    expect(listed.items.map((r: any) => path.basename(r.path))).toEqual(['deep.txt'])
+    expect(fs.existsSync(`${shardPath}-pj`)).toBe(false)
+    await run.app.close()
+  })
+
   test('reset DB clears scanned data but shows drives', async () => {
     const { app, page } = await launch()
     await seedFolder(page, testDir)
@@ -450,6 +1084,354 @@ test.describe('Temp folder performance', () => {
   })
 })
 
+/* ================================================================
+   Level 4 — High-latency filesystem mode (injected latency)
+   ================================================================ */
+
+test.describe('High-latency mode', () => {
+  const LATENCY_MS = 5
+  let treeDir: string
+  let fileCount = 0
+  let totalBytes = 0
+
+  test.beforeAll(() => {
+    treeDir = path.join(os.tmpdir(), `lfb-latency-${Date.now()}`)
+    for (let d = 0; d < 10; d++) {
+      const dir = path.join(treeDir, `dir-${d}`)
+      fs.mkdirSync(dir, { recursive: true })
+      for (let f = 0; f < 20; f++) {
+        const size = 1_000 + d * 100 + f
+        fs.writeFileSync(path.join(dir, `file-${f}.bin`), 'x'.repeat(size))
+        fileCount++
+        totalBytes += size
+      }
+    }
+  })
+  test.afterAll(() => { try { fs.rmSync(treeDir, { recursive: true, force: true }) } catch {} })
+
+  test('auto-detects latency and pipelines metadata requests', async () => {
+    test.setTimeout(60_000)
+    const { app, page } = await launch({ LFB_FS_LATENCY_MS: String(LATENCY_MS) })
+    await resetAndWait(page)
+
+    const t0 = performance.now()
+    await scanAndWait(page, treeDir)
+    const elapsed = performance.now() - t0
+    console.log(`Scanned ${fileCount} files at ${LATENCY_MS}ms latency in ${Math.round(elapsed)}ms ` +
+      `(${Math.round(fileCount / (elapsed / 1000))} files/sec)`)
+
+    // A sequential walk pays at least one round trip per file
+    expect(elapsed).toBeLessThan((fileCount * LATENCY_MS) / 4)
+
+    const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+    const root = roots.items.find((r: any) => r.path === treeDir)
+    expect(root?.sizeBytes).toBe(totalBytes)
+    expect(root?.fileCount).toBe(fileCount)
+
+    await app.close()
+  })
+})
+
+test.describe('Scan progress', () => {
+  // 10 subdirs per level, 20 files per dir, 3 levels deep, at 20 ms a request
+  const SHAPE = '10,20,3'
+  const syntheticRoot = path.resolve(path.sep, 'lfb-synthetic')
+
+  test('a rescan reports a rising percent and an ETA', async () => {
+    test.setTimeout(120_000)
+    const { app, page } = await launch({ LFB_SYNTHETIC_TREE: SHAPE, LFB_FS_LATENCY_MS: '20' })
+    await resetAndWait(page)
+    // The first scan has nothing to go by
+    await scanAndWait(page, syntheticRoot)
+
+    const updates = await page.evaluate(async (dir: string) => new Promise<any[]>((resolve) => {
+      const seen: any[] = []
+      const unsub = window.lfb.onScanStatus((status: any) => {
+        seen.push({ state: status.state, percent: status.percent, etaSeconds: status.etaSeconds })
+        if (status.state !== 'running') { unsub(); resolve(seen) }
+      })
+      window.lfb.scan({ startPath: dir, mode: 'full' })
+    }), syntheticRoot)
+
+    const running = updates.filter((u) => u.state === 'running' && u.percent !== undefined)
+    expect(running.length).toBeGreaterThan(1)
+    const percents = running.map((u) => u.percent)
+    expect(percents).toEqual([...percents].sort((a, b) => a - b))
+    expect(Math.max(...percents)).toBeLessThan(100)
+    expect(running.some((u) => u.etaSeconds !== undefined && u.etaSeconds >= 0)).toBe(true)
+    expect(updates[updates.length - 1]).toMatchObject({ state: 'completed', percent: 100 })
+    await app.close()
+  })
+})
+
+/* ================================================================
+   Level 4a — Synthetic in-memory tree (no disk involved)
+   ================================================================ */
+
+test.describe('Synthetic tree', () => {
+  // 10 subdirs per level, 20 files per dir, 2 levels deep
+  const SHAPE = '10,20,2'
+  const dirs = 1 + 10 + 100
+  const syntheticRoot = path.resolve(path.sep, 'lfb-synthetic')
+
+  test('full scan of a synthetic tree counts every entry', async () => {
+    test.setTimeout(60_000)
+    const { app, page } = await launch({ LFB_SYNTHETIC_TREE: SHAPE })
+    await resetAndWait(page)
+
+    const final = await scanAndWait(page, syntheticRoot)
+    expect(final.state).toBe('completed')
+
+    const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+    const root = roots.items.find((r: any) => r.path === syntheticRoot)
+    expect(root?.fileCount).toBe(dirs * 20)
+    expect(root?.folderCount).toBe(dirs - 1)
+
+    // list-dir goes through the same provider
+    const listing = await page.evaluate((dir: string) => window.lfb.listDir(dir), syntheticRoot)
+    expect(listing.entries.filter((e: any) => e.isDirectory)).toHaveLength(10)
+    await app.close()
+  })
+
+  test('file rows stay within the row budget, the largest of each folder first', async () => {
+    test.setTimeout(60_000)
+    // 5 subdirs per level, 80 files per dir, 2 levels deep: 31 folders, 2480 files
+    const { app, page } = await launch({ LFB_SYNTHETIC_TREE: '5,80,2' })
+    await resetAndWait(page)
+    const FILES_PER_FOLDER = 50
+
+    /** File sizes kept in the DB and listed on disk, for the root and its subfolders. */
+    const keptPerFolder = async () => {
+      const subs = await page.evaluate((p: string) => window.lfb.children({ parent: p, includeFiles: false }), syntheticRoot)
+      const folders: { listed: number[]; kept: number[] }[] = []
+      for (const folder of [syntheticRoot, ...subs.items.map((r: any) => r.path)]) {
+        const rows = await page.evaluate((p: string) => window.lfb.children({ parent: p, limit: 1000 }), folder)
+        const listing = await page.evaluate((p: string) => window.lfb.listDir(p), folder)
+        folders.push({
+          kept: rows.items.filter((r: any) => r.type === 'File').map((r: any) => r.sizeBytes).sort((a: number, b: number) => b - a),
+          listed: listing.entries.filter((e: any) => !e.isDirectory).map((e: any) => e.sizeBytes).sort((a: number, b: number) => b - a)
+        })
+      }
+      return folders
+    }
+    const fileRows = async () => (await page.evaluate(() => window.lfb.top({ type: 'File', limit: 10_000 }))).length
+
+    // A roomy budget: every folder keeps exactly its largest FILES_PER_FOLDER
+    expect((await scanAndWait(page, syntheticRoot, { fileRowBudget: 2_000 })).state).toBe('completed')
+    expect(await fileRows()).toBe(31 * FILES_PER_FOLDER)
+    for (const f of await keptPerFolder()) expect(f.kept).toEqual(f.listed.slice(0, FILES_PER_FOLDER))
+
+    // A tight one: the size threshold rises until the rows fit, and what is
+    // left in each folder is still the top of its listing
+    const BUDGET = 500
+    expect((await scanAndWait(page, syntheticRoot, { fileRowBudget: BUDGET })).state).toBe('completed')
+    const rows = await fileRows()
+    expect(rows).toBeGreaterThan(0)
+    expect(rows).toBeLessThanOrEqual(BUDGET)
+    for (const f of await keptPerFolder()) expect(f.kept).toEqual(f.listed.slice(0, f.kept.length))
+    // Folder totals still count every file
+    const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+    expect(roots.items.find((r: any) => r.path === syntheticRoot)?.fileCount).toBe(31 * 80)
+    await app.close()
+  })
+
+  test('a folder of thousands pages by cursor in milliseconds', async () => {
+    test.setTimeout(120_000)
+    // One folder holding 5000 subfolders
+    const { app } = await launch({ LFB_SYNTHETIC_TREE: '5000,0,1' })
+    const file = path.join(os.tmpdir(), `lfb-pages-${Date.now()}.sqlite`)
+    // Timed in the main process, so IPC doesn't hide the query
+    const ms: number[] = await app.evaluate(async (_electron, { main, file, root }) => {
+      const load = (process as any).getBuiltinModule('node:module').createRequire(main)
+      const { openDatabase, closeDatabase, getChildren } = load('./db.js')
+      const { runScanAsync } = load('./scanner.js')
+      const { db, dbPath } = await openDatabase(file)
+      await runScanAsync({ startPath: root, mode: 'full', db, dbPath })
+      const times: number[] = []
+      let cursor: string | undefined
+      do {
+        const t0 = performance.now()
+        const page = getChildren(db, root, 200, 0, 'size_desc', true, cursor)
+        times.push(performance.now() - t0)
+        cursor = page.nextCursor
+      } while (cursor)
+      await closeDatabase(db, dbPath)
+      return times
+    }, { main: mainEntry, file, root: syntheticRoot })
+    for (const suffix of ['', '-wal', '-shm']) fs.rmSync(file + suffix, { force: true })
+
+    // 25 full pages, then an empty one after the last full page's cursor
+    expect(ms).toHaveLength(26)
+    const median = [...ms].sort((a, b) => a - b)[ms.length >> 1]
+    console.log(`children() page of 200: ${median.toFixed(2)}ms median, ${Math.max(...ms).toFixed(2)}ms slowest`)
+    expect(median).toBeLessThan(10)
+    await app.close()
+  })
+
+  test('rows queued past several commits all land, on a first scan and a rescan', async () => {
+    test.setTimeout(180_000)
+    // 6 subdirs per level, 50 files per dir, 4 levels deep: well past one write batch
+    const big = { dirs: 1 + 6 + 36 + 216 + 1296, files: 50 }
+    const { app, page } = await launch({ LFB_SYNTHETIC_TREE: '6,50,4' })
+    await resetAndWait(page)
+
+    const counts = async () => {
+      const roots = await page.evaluate(() => window.lfb.children({ parent: null }))
+      const root = roots.items.find((r: any) => r.path === syntheticRoot)
+      const children = await page.evaluate((p: string) => window.lfb.children({ parent: p }), syntheticRoot)
+      return { files: root?.fileCount, folders: root?.folderCount, children: children.total }
+    }
+    const expected = { files: big.dirs * big.files, folders: big.dirs - 1, children: 6 + big.files }
+
+    expect((await scanAndWait(page, syntheticRoot)).state).toBe('completed')
+    expect(await counts()).toEqual(expected)
+    expect((await scanAndWait(page, syntheticRoot)).state).toBe('completed')
+    expect(await counts()).toEqual(expected)
+    await app.close()
+  })
+})
+
+/* ================================================================
+   Level 4b — Cancel latency budget
+   ================================================================ */
+
+test.describe('Scan cancellation', () => {
+  const CANCEL_BUDGET_MS = 100
+  let treeDir: string
+
+  test.beforeAll(() => {
+    treeDir = path.join(os.tmpdir(), `lfb-cancel-${Date.now()}`)
+    for (let d = 0; d < 40; d++) {
+      const dir = path.join(treeDir, `dir-${d}`)
+      fs.mkdirSync(dir, { recursive: true })
+      for (let f = 0; f < 500; f++) {
+        fs.writeFileSync(path.join(dir, `file-${f}.bin`), 'x')
+      }
+    }
+  })
+  test.afterAll(() => { try { fs.rmSync(treeDir, { recursive: true, force: true }) } catch {} })
+
+  // Local disk (sequential walker) and a slow share (pipelined walker)
+  for (const latency of [0, 20]) {
+    test(`cancel completes within ${CANCEL_BUDGET_MS}ms (${latency}ms fs latency)`, async () => {
+      test.setTimeout(60_000)
+      const { app, page } = await launch(latency ? { LFB_FS_LATENCY_MS: String(latency) } : undefined)
+      await resetAndWait(page)
+
+      const result = await page.evaluate(async (dir: string) => {
+        let t0 = 0
+        return new Promise<{ state: string; ms: number }>((resolve) => {
+          const unsub = window.lfb.onScanStatus((status: any) => {
+            if (status.state === 'running' && status.itemsScanned > 0 && !t0) {
+              t0 = performance.now()
+              window.lfb.cancelScan(status.runId)
+            } else if (status.state !== 'running') {
+              unsub()
+              resolve({ state: status.state, ms: performance.now() - t0 })
+            }
+          })
+          window.lfb.scan({ startPath: dir, mode: 'full' })
+        })
+      }, treeDir)
+      console.log(`Cancel at ${latency}ms fs latency took ${Math.round(result.ms)}ms`)
+
+      expect(result.state).toBe('cancelled')
+      expect(result.ms).toBeLessThan(CANCEL_BUDGET_MS)
+      await app.close()
+    })
+  }
+})
+
+/* ================================================================
+   Level 4c — Cold start: first paint from the shard catalog
+   ================================================================ */
+
+test.describe('Cold start', () => {
+  // 10 subdirs per level, 40 files per dir, 3 levels deep (~44k files)
+  const SHAPE = '10,40,3'
+  const syntheticRoot = path.resolve(path.sep, 'lfb-synthetic')
+  // Shards open no sooner than this; the first rows must beat it by far
+  const OPEN_DELAY_MS = 10_000
+  const PAINT_BUDGET_MS = 5_000
+
+  // Native engine and the sql.js fallback, which has WASM to instantiate
+  for (const engine of ['native', 'sqljs']) {
+    test(`first rows paint before the database loads (${engine})`, async () => {
+      test.setTimeout(120_000)
+      const env: Record<string, string> = { LFB_SYNTHETIC_TREE: SHAPE }
+      if (engine === 'sqljs') env.LFB_SQLITE_ENGINE = 'sqljs'
+
+      // Seed one scanned root; quitting writes the catalog
+      const seeded = await launch(env)
+      await resetAndWait(seeded.page)
+      await scanAndWait(seeded.page, syntheticRoot)
+      await seeded.app.close()
+
+      // Every shard now takes OPEN_DELAY_MS to load, so rows painted sooner
+      // came from the catalog
+      const t0 = Date.now()
+      const { app, page } = await launch({ ...env, LFB_SHARD_OPEN_DELAY_MS: String(OPEN_DELAY_MS) })
+      await expect(page.getByTestId('item-row').first()).toBeVisible({ timeout: 30_000 })
+      const sinceLaunch = Date.now() - t0
+      // Renderer clock: time from navigation start to the painted rows
+      const sinceNavigation = await page.evaluate(() => performance.now())
+      console.log(`Cold start (${engine}): first rows ${sinceLaunch}ms after launch, ` +
+        `${Math.round(sinceNavigation)}ms after navigation`)
+      expect(sinceNavigation).toBeLessThan(PAINT_BUDGET_MS)
+
+      const top = await page.evaluate(() => window.lfb.top({ type: 'Folder', limit: 10 }))
+      expect(top.length).toBeGreaterThan(0)
+      await app.close()
+    })
+  }
+})
+
+/* ================================================================
+   Level 4d — Statement cache micro-benchmark
+   ================================================================ */
+
+test.describe('Statement cache', () => {
+  const SHAPE = '10,20,2'
+  const syntheticRoot = path.resolve(path.sep, 'lfb-synthetic')
+  const CALLS = 2_000
+
+  test('cached statements answer folder listings faster', async () => {
+    test.setTimeout(120_000)
+    const perCall: Record<string, number> = {}
+    // LFB_STMT_CACHE=0 compiles every query on every call, as before the cache
+    for (const cache of ['1', '0']) {
+      const { app } = await launch({ LFB_SYNTHETIC_TREE: SHAPE, LFB_STMT_CACHE: cache })
+      const file = path.join(os.tmpdir(), `lfb-stmt-${cache}-${Date.now()}.sqlite`)
+      // Timed in the main process: an IPC round trip would hide the prepare
+      perCall[cache] = await app.evaluate(async (_electron, { main, file, root, calls }) => {
+        const load = (process as any).getBuiltinModule('node:module').createRequire(main)
+        const { openDatabase, closeDatabase, getChildren, getItemByPath } = load('./db.js')
+        const { runScanAsync } = load('./scanner.js')
+        const { db, dbPath } = await openDatabase(file)
+        await runScanAsync({ startPath: root, mode: 'full', db, dbPath })
+        const dirs: string[] = getChildren(db, root, 200, 0, 'size_desc', false).items.map((r: any) => r.path)
+        // One row a listing, so compiling the query is most of the work
+        const call = (i: number) => {
+          getChildren(db, dirs[i % dirs.length], 1)
+          getItemByPath(db, dirs[i % dirs.length])
+        }
+        // Warm up, then time
+        for (let i = 0; i < dirs.length; i++) call(i)
+        const t0 = performance.now()
+        for (let i = 0; i < calls; i++) call(i)
+        const ms = (performance.now() - t0) / calls
+        await closeDatabase(db, dbPath)
+        return ms
+      }, { main: mainEntry, file, root: syntheticRoot, calls: CALLS })
+      for (const suffix of ['', '-wal', '-shm']) fs.rmSync(file + suffix, { force: true })
+      await app.close()
+    }
+    console.log(`children() + item lookup: ${Math.round(perCall['1'] * 1000)}us cached, ` +
+      `${Math.round(perCall['0'] * 1000)}us uncached (${CALLS} calls)`)
+    expect(perCall['1']).toBeLessThan(perCall['0'])
+  })
+})
+
 /* ================================================================
    Level 5 — Full C: drive scan for memory stress testing
    ================================================================ */